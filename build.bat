@@ -1,8 +1,18 @@
 @echo off
 
-set SRC_FILES=src\Main.cpp src\Lexer.cpp src\Term.cpp src\Parser.cpp src\Program.cpp src\Machine.cpp src\Utils.cpp
+if not exist build\obj mkdir build\obj
+
+rem Everything but the command line is built into cfmc.lib, for embedding
+set LIB_FILES=src\Lexer.cpp src\Term.cpp src\Parser.cpp src\Program.cpp src\Machine.cpp src\Utils.cpp src\Fusion.cpp src\Loop.cpp src\Embedded.cpp src\Symbol.cpp src\MappedFile.cpp src\ThreadPool.cpp src\Image.cpp src\Module.cpp src\Reloader.cpp src\Output.cpp src\Input.cpp src\Device.cpp src\MappedStack.cpp src\Printer.cpp src\Host.cpp src\Batch.cpp src\WorkStealingPool.cpp src\Channel.cpp
 
 echo Compiling...
-cl /std:c++20 /DEBUG:FULL /Zi /EHsc /Fo.\build\ /Fd.\build\cfmc.pdb %SRC_FILES% /link /out:build\cfmc.exe
+cl /c /std:c++20 /DEBUG:FULL /Zi /EHsc /Fo.\build\obj\ /Fd.\build\cfmc.pdb %LIB_FILES%
+lib /nologo /out:build\cfmc.lib build\obj\*.obj
+
+cl /std:c++20 /DEBUG:FULL /Zi /EHsc /Fo.\build\ /Fd.\build\cfmc.pdb src\Main.cpp build\cfmc.lib /link /out:build\cfmc.exe
+
+rem Examples of embedding, which check their own results
+cl /std:c++20 /DEBUG:FULL /Zi /EHsc /Isrc /Fo.\build\ /Fd.\build\cfmc.pdb examples\HostFunc.cpp build\cfmc.lib /link /out:build\host_func.exe
+cl /std:c++20 /DEBUG:FULL /Zi /EHsc /Isrc /Fo.\build\ /Fd.\build\cfmc.pdb examples\Embedded.cpp build\cfmc.lib /link /out:build\embedded.exe
 
 echo Done...!
\ No newline at end of file
@@ -1,10 +1,22 @@
 #!/bin/bash
 
-mkdir -p build
+mkdir -p build/obj
 
-SRC_FILES="src/Main.cpp src/Lexer.cpp src/Term.cpp src/Parser.cpp src/Program.cpp src/Machine.cpp src/Utils.cpp"
+# Everything but the command line is built into libcfmc, for embedding
+LIB_FILES="src/Lexer.cpp src/Term.cpp src/Parser.cpp src/Program.cpp src/Machine.cpp src/Utils.cpp src/Fusion.cpp src/Loop.cpp src/Embedded.cpp src/Symbol.cpp src/MappedFile.cpp src/ThreadPool.cpp src/Image.cpp src/Module.cpp src/Reloader.cpp src/Output.cpp src/Input.cpp src/Device.cpp src/MappedStack.cpp src/Printer.cpp src/Host.cpp src/Batch.cpp src/WorkStealingPool.cpp src/Channel.cpp"
 
 echo 'Compiling...'
-c++ -std=c++20 -g -o build/cfmc $SRC_FILES
+for SRC_FILE in $LIB_FILES; do
+	c++ -std=c++20 -g -pthread -c -o build/obj/$(basename $SRC_FILE .cpp).o $SRC_FILE || exit 1
+done
+
+rm -f build/libcfmc.a
+ar rcs build/libcfmc.a build/obj/*.o
+
+c++ -std=c++20 -g -pthread -o build/cfmc src/Main.cpp build/libcfmc.a
+
+# Examples of embedding, which check their own results
+c++ -std=c++20 -g -pthread -Isrc -o build/host_func examples/HostFunc.cpp build/libcfmc.a || exit 1
+c++ -std=c++20 -g -pthread -Isrc -o build/embedded examples/Embedded.cpp build/libcfmc.a || exit 1
 
 echo 'Done...!'
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include <string>
+#include <string_view>
+#include <optional>
+#include <iostream>
+
+#include "Parser.hpp"
+#include "Program.hpp"
+#include "Machine.hpp"
+#include "Output.hpp"
+#include "Printer.hpp"
+#include "Embedded.hpp"
+
+// Feeds the same sources through 'Parser' & 'EmbeddedParser' (see
+// 'Embedded.hpp'), checking both give the same definitions & the same output,
+// as the embedded grammar is a second copy of the parser's
+
+static std::string run(const Program &program)
+{
+	std::string str;
+	OutputSink output(str);
+
+	Machine machine;
+	machine.setOutput(output);
+
+	if (auto errorOpt = machine.tryExecute(program))
+	{
+		return errorOpt.value();
+	}
+
+	output.flush();
+	return str;
+}
+
+template<EmbeddedSource Source>
+static bool agree(std::string_view name)
+{
+	Parser parser;
+
+	std::optional<Program> parsed;
+	if (auto errorOpt = parser.tryParseProgram(Source.view(), parsed))
+	{
+		std::cerr << name << ": " << errorOpt.value();
+		return false;
+	}
+
+	Program embedded = EmbeddedProgram<Source>::load();
+
+	Program::FuncRanges_t ranges;
+	parser.tryScanFuncDefs(Source.view(), ranges);
+
+	if (ranges.size() != EmbeddedProgram<Source>::s_Table.Funcs.size())
+	{
+		std::cerr << name << ": Parsed " << ranges.size() << " definitions, embedded "
+			<< EmbeddedProgram<Source>::s_Table.Funcs.size() << std::endl;
+		return false;
+	}
+
+	Printer printer;
+	bool isAgreed = true;
+
+	for (auto itRanges = ranges.begin(); itRanges != ranges.end(); ++itRanges)
+	{
+		std::string parsedStr;
+		std::string embeddedStr;
+
+		if (auto termOpt = parsed->load(itRanges->first))
+		{
+			printer.printTerm(parsedStr, termOpt.value());
+		}
+		if (auto termOpt = embedded.load(itRanges->first))
+		{
+			printer.printTerm(embeddedStr, termOpt.value());
+		}
+
+		if (parsedStr != embeddedStr)
+		{
+			std::cerr << name << ": Definitions of '" << getSymbolName(itRanges->first) << "' differ" << '\n'
+				<< "  Parsed:   " << parsedStr << '\n'
+				<< "  Embedded: " << embeddedStr << std::endl;
+			isAgreed = false;
+		}
+	}
+
+	std::string parsedOutput = run(parsed.value());
+	std::string embeddedOutput = run(embedded);
+
+	if (parsedOutput != embeddedOutput)
+	{
+		std::cerr << name << ": Outputs differ" << '\n'
+			<< "  Parsed:   " << parsedOutput << '\n'
+			<< "  Embedded: " << embeddedOutput << std::endl;
+		isAgreed = false;
+	}
+
+	std::cout << name << ": " << parsedOutput;
+	return isAgreed;
+}
+
+int main()
+{
+	bool isAgreed = true;
+
+	isAgreed &= agree<R"(
+multiply_aux = (
+    <t> . <n> . <m> . [m] . (
+        0 -> [t],
+        otherwise -> [m] . [1] . - . [n] . [t] . [n] . + . multiply_aux
+    )
+)
+multiply = ([0] . multiply_aux)
+
+main = ([300] . [500] . multiply . <x> . [x]out)
+)">("arithmetic");
+
+	isAgreed &= agree<R"(
+get   = (<@a> . a<x> . [x]a . [x])
+write = (<@a> . <x> . [x]a)
+print = ([#out] . write)
+main  = (new<@a> . [5]a . new<@b> . [2]b . [#a] . get . print . [#b] . get . print . [#a]out)
+)">("locations");
+
+	isAgreed &= agree<R"(
+main = (
+    [3] . (1 -> [10]out, 3 -> [30]out, otherwise -> [0]out) .
+    [#null] . (null -> [1]out, otherwise -> [2]out) .
+    [7] . <_> . [<y> . [y]out] . <f> . [4] . f
+)
+)">("cases");
+
+	isAgreed &= agree<R"(
+util::double = (<x> . [x] . [x] . +)
+util::quadruple = (util::double . util::double)
+main = ([3] . util::quadruple . <y> . [y]out)
+)">("qualified");
+
+	if (!isAgreed)
+	{
+		std::cerr << "Embedded programs don't match the parser !" << std::endl;
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
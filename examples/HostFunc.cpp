@@ -0,0 +1,82 @@
+#include <string>
+#include <string_view>
+#include <optional>
+#include <iostream>
+#include <span>
+
+#include "Parser.hpp"
+#include "Program.hpp"
+#include "Machine.hpp"
+#include "Output.hpp"
+
+// Runs 'multiply' of 'arithmetic.fmc' as it's defined, then with a native
+// 'multiply_aux' (see 'Program::addHostFunc'), checking both give the product
+
+const std::string_view k_Source = R"(
+write = (<@a> . <x> . [x]a)
+print = ([#out] . write)
+
+multiply_aux = (
+    <t> . <n> . <m> . [m] . (
+        0 -> [t],
+        otherwise -> [m] . [1] . - . [n] . [t] . [n] . + . multiply_aux
+    )
+)
+multiply = ([0] . multiply_aux)
+
+main = (
+    [3000] . [5000] . multiply . print
+)
+)";
+
+static size_t s_NumNativeCalls = 0;
+
+static std::string run(bool isNative)
+{
+	Parser parser;
+
+	std::optional<Program> program;
+	if (auto errorOpt = parser.tryParseProgram(k_Source, program))
+	{
+		return errorOpt.value();
+	}
+
+	// Arguments are 't', 'n' & 'm', from the top of 'lambda'
+	if (isNative)
+	{
+		program->addHostFunc("multiply_aux", HostFunc({k_LambdaLoc, k_LambdaLoc, k_LambdaLoc}, {k_LambdaLoc},
+			[](std::span<const Prim_t> args, std::span<Prim_t> results) {
+				results[0] = args[0] + args[1] * args[2];
+				s_NumNativeCalls++;
+			}));
+	}
+
+	std::string str;
+	OutputSink output(str);
+
+	Machine machine;
+	machine.setOutput(output);
+
+	if (auto errorOpt = machine.tryExecute(program.value()))
+	{
+		return errorOpt.value();
+	}
+
+	output.flush();
+	return str;
+}
+
+int main()
+{
+	std::string defined = run(false);
+	std::string native = run(true);
+
+	std::cout << "Defined: " << defined << "Native:  " << native;
+
+	if (defined != native || defined != "15000000\n" || s_NumNativeCalls != 1)
+	{
+		std::cerr << "Native 'multiply_aux' doesn't match its definition !" << std::endl;
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "Batch.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "Machine.hpp"
+#include "Device.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+BatchRunner::BatchRunner(const Program &program, size_t numJobs)
+	: m_Program(program)
+	, m_NumJobs(std::max<size_t>(numJobs, 1))
+{}
+
+void BatchRunner::setLoops(bool isEnabled)
+{
+	m_IsLoopsEnabled = isEnabled;
+}
+
+void BatchRunner::setBinaryIo(bool isEnabled)
+{
+	m_IsBinaryIo = isEnabled;
+}
+
+void BatchRunner::setMaxSteps(uint64_t maxSteps)
+{
+	m_MaxSteps = maxSteps;
+}
+
+bool BatchRunner::run(const std::string &dir, OutputSink &output)
+{
+	std::vector<std::string> paths;
+
+	std::error_code error;
+	for (const auto &entry : std::filesystem::directory_iterator(dir, error))
+	{
+		if (entry.is_regular_file())
+		{
+			paths.push_back(entry.path().string());
+		}
+	}
+
+	if (error)
+	{
+		return false;
+	}
+
+	std::sort(paths.begin(), paths.end());
+
+	m_Latencies.clear();
+	m_NumFailed = 0;
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	// Records are written in order, so only so many are run ahead of the one
+	// being written (which bounds the outputs held in memory)
+	std::deque<Record> records;
+	std::mutex mutex;
+	std::condition_variable doneCond;
+
+	{
+		ThreadPool pool(m_NumJobs);
+		size_t numQueued = 0;
+
+		auto queue = [&]() {
+			while (numQueued < paths.size() && records.size() < m_NumJobs * s_QueueDepth)
+			{
+				Record &record = records.emplace_back();
+				record.Path = paths[numQueued++];
+
+				pool.push([&, this]() {
+					runRecord(record);
+					{
+						std::lock_guard lock(mutex);
+						record.IsDone = true;
+					}
+					doneCond.notify_all();
+				});
+			}
+		};
+
+		std::unique_lock lock(mutex);
+		queue();
+
+		while (!records.empty())
+		{
+			Record &record = records.front();
+			doneCond.wait(lock, [&]() { return record.IsDone; });
+
+			lock.unlock();
+
+			output.write(record.Output);
+
+			if (record.Error)
+			{
+				output.flush();
+				std::cerr << "[Record '" << record.Path << "']" << std::endl;
+				std::cerr << record.Error.value() << std::flush;
+				m_NumFailed++;
+			}
+
+			m_Latencies.push_back(record.Latency.count());
+
+			lock.lock();
+
+			// Deque elements stay put when others are added or removed at the ends
+			records.pop_front();
+			queue();
+		}
+	}
+
+	output.flush();
+	m_Elapsed = std::chrono::steady_clock::now() - startTime;
+
+	return m_NumFailed == 0;
+}
+
+std::string BatchRunner::getStatsDebug() const
+{
+	std::vector<double> latencies = m_Latencies;
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&](double p) {
+		if (latencies.empty())
+		{
+			return 0.0;
+		}
+		size_t idx = static_cast<size_t>(p * (latencies.size() - 1) + 0.5);
+		return latencies[idx] * 1000.0;
+	};
+
+	std::stringstream ss;
+
+	ss << "---- Batch ----" << '\n';
+	ss << "  -- " << latencies.size() << " record(s) on " << m_NumJobs << " job(s), " << m_NumFailed << " failed" << '\n';
+	ss << "  -- " << m_Elapsed.count() * 1000.0 << " ms (" << latencies.size() / std::max(m_Elapsed.count(), 1e-9) << " records/s)" << '\n';
+	ss << "  -- Latency p50 " << percentile(0.5) << " ms, p90 " << percentile(0.9) << " ms, p99 " << percentile(0.99)
+		<< " ms, max " << percentile(1.0) << " ms" << '\n';
+	ss << "---------------";
+
+	return ss.str();
+}
+
+void BatchRunner::runRecord(Record &record) const
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	auto fileOpt = MappedFile::open(record.Path);
+	if (!fileOpt)
+	{
+		record.Error = "File '" + record.Path + "' could not be read.\n";
+		return;
+	}
+
+	InputSource input(std::move(fileOpt.value()));
+
+	// Only written once the machine is done
+	OutputSink output(record.Output);
+	output.setFlushPolicy(OutputSink::FlushPolicy::Exit);
+
+	Machine machine;
+	machine.setLoops(m_IsLoopsEnabled);
+	machine.setMaxSteps(m_MaxSteps);
+	machine.setInput(input);
+	machine.setOutput(output);
+
+	if (m_IsBinaryIo)
+	{
+		machine.addDevice("in", std::make_unique<BinaryInputDevice>());
+		machine.addDevice("out", std::make_unique<BinaryOutputDevice>());
+	}
+
+	record.Error = machine.tryExecute(m_Program);
+	output.flush();
+
+	record.Latency = std::chrono::steady_clock::now() - startTime;
+}
\ No newline at end of file
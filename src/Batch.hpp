@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <chrono>
+
+#include "Program.hpp"
+#include "Output.hpp"
+
+// Runs a program over many inputs (records) concurrently, each on a machine of
+// its own with its own input & output, so only the program (which isn't
+// changed by running it) is shared between the worker threads.
+class BatchRunner
+{
+public:
+	BatchRunner(const Program &program, size_t numJobs);
+
+	// Options of each machine, see 'Machine'
+	void setLoops(bool isEnabled);
+	void setBinaryIo(bool isEnabled);
+	void setMaxSteps(uint64_t maxSteps);
+
+	// Runs the program with each file of the directory (in order of name) as
+	// its input, writing the outputs to 'output' in that same order. Errors are
+	// displayed as they're reached, and don't stop the other records. False if
+	// the directory can't be read or any record failed.
+	bool run(const std::string &dir, OutputSink &output);
+
+	// Throughput & percentiles of the latency of each record
+	std::string getStatsDebug() const;
+
+private:
+	struct Record
+	{
+		std::string Path;
+		std::string Output;
+		std::optional<std::string> Error;
+		std::chrono::duration<double> Latency = {};
+		bool IsDone = false;
+	};
+
+	void runRecord(Record &record) const;
+
+private:
+	const Program &m_Program;
+	size_t m_NumJobs;
+
+	bool m_IsLoopsEnabled = true;
+	bool m_IsBinaryIo = false;
+	uint64_t m_MaxSteps = 0;
+
+	// Of the last run
+	std::vector<double> m_Latencies;
+	std::chrono::duration<double> m_Elapsed = {};
+	size_t m_NumFailed = 0;
+
+	// Records queued ahead of the one being written, per worker
+	static const size_t s_QueueDepth = 64;
+};
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "Channel.hpp"
+
+#include <sstream>
+#include <unordered_map>
+#include <mutex>
+
+#include "Utils.hpp"
+
+struct ChannelTable
+{
+	std::mutex Mutex;
+	std::unordered_map<Loc_t, std::weak_ptr<Channel>> Channels;
+	uint32_t NumCreated = 0;
+};
+
+static ChannelTable &getChannelTable()
+{
+	static ChannelTable table;
+	return table;
+}
+
+Channel::Channel(size_t capacity)
+	: m_Queue(capacity)
+{}
+
+template <typename F>
+bool Channel::wait(F &&isDone, const std::atomic<bool> &isStopped, std::atomic<uint64_t> &waitNs)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	bool isReady = false;
+
+	while (true)
+	{
+		// Read before trying, so a change in between isn't slept through
+		uint32_t seen = m_Version;
+
+		if ((isReady = isDone()) || isStopped)
+		{
+			break;
+		}
+
+		m_NumParked++;
+		m_Version.wait(seen);
+		m_NumParked--;
+	}
+
+	std::chrono::nanoseconds waited = std::chrono::steady_clock::now() - startTime;
+	waitNs += waited.count();
+
+	return isReady;
+}
+
+void Channel::wake()
+{
+	m_Version++;
+
+	if (m_NumParked > 0)
+	{
+		m_Version.notify_all();
+	}
+
+	// Paired with the one in 'addWaiter', so either the waiter is seen here
+	// or the push (or pop) is seen there
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (m_NumWaiters > 0)
+	{
+		wakeWaiters();
+	}
+}
+
+void Channel::wakeWaiters()
+{
+	std::vector<std::function<void()>> waiters;
+	{
+		std::lock_guard lock(m_WaitersMutex);
+		waiters.swap(m_Waiters);
+		m_NumWaiters = 0;
+	}
+
+	for (const auto &waiter : waiters)
+	{
+		waiter();
+	}
+}
+
+bool Channel::push(const Value_t &value, const std::atomic<bool> &isStopped)
+{
+	if (!m_Queue.tryPush(value) && !wait([&]() { return m_Queue.tryPush(value); }, isStopped, m_PushWaitNs))
+	{
+		return false;
+	}
+
+	m_NumPushed++;
+	wake();
+
+	return true;
+}
+
+std::optional<Channel::Value_t> Channel::pop(const std::atomic<bool> &isStopped)
+{
+	Value_t value;
+
+	if (!m_Queue.tryPop(value) && !wait([&]() { return m_Queue.tryPop(value); }, isStopped, m_PopWaitNs))
+	{
+		return std::nullopt;
+	}
+
+	m_NumPopped++;
+	wake();
+
+	return value;
+}
+
+bool Channel::canPush() const
+{
+	return m_Queue.getSizeHint() < m_Queue.getCapacity();
+}
+
+bool Channel::canPop() const
+{
+	return m_Queue.getSizeHint() > 0;
+}
+
+void Channel::addWaiter(bool isPush, std::function<void()> &&wake)
+{
+	{
+		std::lock_guard lock(m_WaitersMutex);
+		m_Waiters.push_back(std::move(wake));
+		m_NumWaiters++;
+	}
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Pushed (or popped) since the machine looked, before the waiter was seen,
+	// so it's woken to look again
+	if (isPush ? canPush() : canPop())
+	{
+		wakeWaiters();
+	}
+}
+
+std::string Channel::getStatsDebug() const
+{
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_CreationTime;
+
+	std::stringstream ss;
+	ss << m_NumPushed << " pushed, " << m_NumPopped << " popped ("
+		<< m_NumPopped / std::max(elapsed.count(), 1e-9) << " values/s), waited "
+		<< m_PushWaitNs / 1e6 << " ms to push & " << m_PopWaitNs / 1e6 << " ms to pop";
+
+	return ss.str();
+}
+
+std::pair<Loc_t, std::shared_ptr<Channel>> Channel::create()
+{
+	ChannelTable &table = getChannelTable();
+	std::lock_guard lock(table.Mutex);
+
+	// Channels nothing holds anymore are dropped as others are created
+	if (table.NumCreated % 64 == 0)
+	{
+		std::erase_if(table.Channels, [](const auto &entry) { return entry.second.expired(); });
+	}
+
+	Loc_t loc = getChannelLoc(table.NumCreated++);
+	auto channel = std::make_shared<Channel>(s_Capacity);
+	table.Channels[loc] = channel;
+
+	return std::make_pair(loc, channel);
+}
+
+std::shared_ptr<Channel> Channel::find(Loc_t loc)
+{
+	ChannelTable &table = getChannelTable();
+	std::lock_guard lock(table.Mutex);
+
+	auto itChannel = table.Channels.find(loc);
+	if (itChannel != table.Channels.end())
+	{
+		return itChannel->second.lock();
+	}
+	return nullptr;
+}
\ No newline at end of file
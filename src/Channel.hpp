@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <variant>
+#include <optional>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <cinttypes>
+
+#include "Config.hpp"
+#include "MpmcQueue.hpp"
+
+// Queue of values shared by machines on any number of threads, created by
+// 'chan' (see 'ChanDevice'). Channels are found by location from any machine,
+// so their locations are numbered by the process rather than by a machine.
+//
+// Only primitives & locations are carried, as other terms (and environments)
+// are owned by the machine which created them. Pushing to a full channel, or
+// popping from an empty one, parks the thread until it can carry on, unless
+// the machine is run in slices (as spawned ones are), which waits without a
+// thread instead, see 'addWaiter'.
+class Channel
+{
+public:
+	using Value_t = std::variant<Prim_t, Loc_t>;
+
+	explicit Channel(size_t capacity);
+
+	// Both give up (returning false or nothing) if 'isStopped' is set while
+	// they're waiting
+	bool push(const Value_t &value, const std::atomic<bool> &isStopped);
+	std::optional<Value_t> pop(const std::atomic<bool> &isStopped);
+
+	// Whether a push (or pop) would go ahead without waiting, which is only a
+	// hint while other threads are using the channel
+	bool canPush() const;
+	bool canPop() const;
+
+	// 'wake' is called once by the next push or pop (or straight away if the
+	// push, or pop, can already go ahead), for a machine which parked rather
+	// than waiting on the channel
+	void addWaiter(bool isPush, std::function<void()> &&wake);
+
+	// Values carried per second (since it was created) & time spent waiting
+	std::string getStatsDebug() const;
+
+	// The channel is found by location for as long as anything holds it
+	static std::pair<Loc_t, std::shared_ptr<Channel>> create();
+	static std::shared_ptr<Channel> find(Loc_t loc);
+
+	static constexpr size_t s_Capacity = 1024;
+
+private:
+	// Parks until 'isDone' gives true, false if stopped first
+	template <typename F>
+	bool wait(F &&isDone, const std::atomic<bool> &isStopped, std::atomic<uint64_t> &waitNs);
+	void wake();
+	void wakeWaiters();
+
+private:
+	MpmcQueue<Value_t> m_Queue;
+
+	// Bumped by each push & pop, which parked pops & pushes wait on
+	std::atomic<uint32_t> m_Version = 0;
+	std::atomic<uint32_t> m_NumParked = 0;
+
+	std::mutex m_WaitersMutex;
+	std::vector<std::function<void()>> m_Waiters;
+	std::atomic<uint32_t> m_NumWaiters = 0;
+
+	std::atomic<uint64_t> m_NumPushed = 0;
+	std::atomic<uint64_t> m_NumPopped = 0;
+
+	std::atomic<uint64_t> m_PushWaitNs = 0;
+	std::atomic<uint64_t> m_PopWaitNs = 0;
+
+	std::chrono::steady_clock::time_point m_CreationTime = std::chrono::steady_clock::now();
+};
\ No newline at end of file
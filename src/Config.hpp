@@ -4,14 +4,29 @@
 #include <string_view>
 #include <cinttypes>
 
-using Var_t = std::string;
-using LocVar_t = std::string;
+#include "Symbol.hpp"
 
-using Loc_t = std::string;
+using Var_t = Symbol_t;
+using LocVar_t = Symbol_t;
+
+using Loc_t = Symbol_t;
 using Prim_t = int32_t;
 
-const Loc_t k_LambdaLoc = "lambda";
-const Loc_t k_NewLoc     = "new";
-const Loc_t k_InputLoc   = "in";
-const Loc_t k_OutputLoc  = "out";
-const Loc_t k_NullLoc    = "null";
\ No newline at end of file
+// Reserved locations are the first symbols to be interned (in this order)
+constexpr std::string_view k_ReservedLocIds[] = {
+	"lambda", "new", "in", "out", "null"
+};
+
+constexpr Loc_t k_LambdaLoc  = 0;
+constexpr Loc_t k_NewLoc     = 1;
+constexpr Loc_t k_InputLoc   = 2;
+constexpr Loc_t k_OutputLoc  = 3;
+constexpr Loc_t k_NullLoc    = 4;
+
+constexpr Loc_t k_NumReservedLocs = 5;
+
+// Locations created by 'new' aren't symbols, they're numbered by the machine
+constexpr Loc_t k_FreshLocBit = 0x80000000;
+// Locations created by 'chan' are shared by every machine, so they're numbered
+// by the process instead, and told apart from the others by this bit as well
+constexpr Loc_t k_ChanLocBit = 0x40000000;
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "Device.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <variant>
+
+#include "Utils.hpp"
+
+// Values (and variables bound to them) are written without stringifying
+static TermHandle_t resolveValue(const Env_t &env, TermHandle_t term)
+{
+	if (term->isVar() && (!term->getBody() || term->getBody()->isNil()))
+	{
+		auto itEnv = env.first.find(term->asVar().getVar());
+		if (itEnv != env.first.end())
+		{
+			const Closure_t *binding = reinterpret_cast<const Closure_t *>(itEnv->second.get());
+			if (binding->second->isVal())
+			{
+				return binding->second;
+			}
+		}
+	}
+	return term;
+}
+
+bool Device::push(Machine &, const Env_t &, TermHandle_t)
+{
+	return false;
+}
+
+bool Device::pushLoc(Machine &, Loc_t)
+{
+	return false;
+}
+
+std::optional<Closure_t> Device::pop(Machine &)
+{
+	return std::nullopt;
+}
+
+std::optional<Loc_t> Device::popLoc(Machine &)
+{
+	return std::nullopt;
+}
+
+bool Device::canPush(const Machine &)
+{
+	return true;
+}
+
+bool Device::canPop(const Machine &)
+{
+	return true;
+}
+
+std::optional<Closure_t> NewDevice::pop(Machine &machine)
+{
+	return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(machine.freshLoc())));
+}
+
+std::optional<Loc_t> NewDevice::popLoc(Machine &machine)
+{
+	return machine.freshLoc();
+}
+
+std::optional<Closure_t> InputDevice::pop(Machine &machine)
+{
+	// Prompts are seen before blocking on input
+	machine.getOutput().flush();
+
+	std::string_view word = machine.getInput().nextWord().value_or("");
+
+	auto isDigit = [](char c) { return c >= '0' && c <= '9'; };
+	auto isAlpha = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); };
+
+	// Primitives & locations are decoded directly, anything else is parsed
+	if (!word.empty() && std::all_of(word.begin(), word.end(), isDigit))
+	{
+		int64_t prim = 0;
+		for (char c : word)
+		{
+			prim = prim * 10 + (c - '0');
+			if (prim > INT32_MAX)
+			{
+				break;
+			}
+		}
+
+		if (prim <= INT32_MAX)
+		{
+			return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(static_cast<Prim_t>(prim))));
+		}
+	}
+	else if (word.size() > 1 && word[0] == '#' && isAlpha(word[1]) && std::all_of(word.begin() + 1, word.end(),
+		[&](char c) { return isAlpha(c) || isDigit(c) || c == '_'; }))
+	{
+		return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(internSymbol(word.substr(1)))));
+	}
+
+	return parseTerm(machine, word);
+}
+
+bool InputDevice::canPop(const Machine &machine)
+{
+	return machine.getInput().isWordReady();
+}
+
+Closure_t InputDevice::parseTerm(Machine &machine, std::string_view source)
+{
+	std::optional<TermHandle_t> termOpt;
+
+	// Input which doesn't parse is an error of the machine, not the program
+	if (!Parser().tryParseTerm(source, m_Terms.emplace_back(), termOpt) && termOpt)
+	{
+		return std::make_pair(Env_t{}, termOpt.value());
+	}
+
+	machine.error("Cannot parse input '" + std::string(source) + "' as term !");
+	return {};
+}
+
+std::optional<Closure_t> BinaryInputDevice::pop(Machine &machine)
+{
+	// Prompts are seen before blocking on input
+	machine.getOutput().flush();
+
+	auto frameOpt = machine.getInput().nextFrame();
+	if (!frameOpt)
+	{
+		machine.error("Cannot read frame from input, it has ended !");
+		return std::nullopt;
+	}
+
+	auto [tag, payload] = frameOpt.value();
+
+	switch (tag)
+	{
+	case FrameTag::Prim:
+		if (payload.size() == sizeof(Prim_t))
+		{
+			Prim_t prim;
+			std::memcpy(&prim, payload.data(), sizeof(prim));
+			return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(prim)));
+		}
+		break;
+	case FrameTag::Loc:
+		if (!payload.empty())
+		{
+			return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(internSymbol(payload))));
+		}
+		break;
+	case FrameTag::Term:
+		return parseTerm(machine, payload);
+	}
+
+	machine.error("Cannot read frame from input, it isn't a valid frame !");
+	return std::nullopt;
+}
+
+bool BinaryInputDevice::canPop(const Machine &machine)
+{
+	return machine.getInput().isFrameReady();
+}
+
+bool OutputDevice::push(Machine &machine, const Env_t &env, TermHandle_t term)
+{
+	OutputSink &output = machine.getOutput();
+
+	term = resolveValue(env, term);
+
+	if (term->isVal())
+	{
+		const ValTerm &val = term->asVal();
+
+		if (val.isPrim())
+		{
+			output.writePrim(val.asPrim());
+		}
+		else
+		{
+			m_Buffer.clear();
+			Printer::printLoc(m_Buffer, val.asLoc());
+			output.writeLine(m_Buffer);
+		}
+		return true;
+	}
+
+	m_Buffer.clear();
+	m_Printer.printClosure(m_Buffer, env, term);
+	output.writeLine(m_Buffer);
+	return true;
+}
+
+bool OutputDevice::pushLoc(Machine &machine, Loc_t loc)
+{
+	m_Buffer.clear();
+	Printer::printLoc(m_Buffer, loc);
+	machine.getOutput().writeLine(m_Buffer);
+	return true;
+}
+
+bool BinaryOutputDevice::push(Machine &machine, const Env_t &env, TermHandle_t term)
+{
+	OutputSink &output = machine.getOutput();
+
+	term = resolveValue(env, term);
+
+	if (term->isVal())
+	{
+		const ValTerm &val = term->asVal();
+
+		if (val.isPrim())
+		{
+			Prim_t prim = val.asPrim();
+			output.writeFrame(FrameTag::Prim, std::string_view(reinterpret_cast<const char *>(&prim), sizeof(prim)));
+		}
+		else
+		{
+			output.writeFrame(FrameTag::Loc, getLocName(val.asLoc()));
+		}
+		return true;
+	}
+
+	m_Buffer.clear();
+	m_Printer.printClosure(m_Buffer, env, term);
+	output.writeFrame(FrameTag::Term, m_Buffer);
+	return true;
+}
+
+bool BinaryOutputDevice::pushLoc(Machine &machine, Loc_t loc)
+{
+	machine.getOutput().writeFrame(FrameTag::Loc, getLocName(loc));
+	return true;
+}
+
+bool NullDevice::push(Machine &, const Env_t &, TermHandle_t)
+{
+	return true;
+}
+
+bool NullDevice::pushLoc(Machine &, Loc_t)
+{
+	return true;
+}
+
+bool SpawnDevice::push(Machine &machine, const Env_t &env, TermHandle_t term)
+{
+	m_Handles.push_back(machine.spawn(env, term));
+	return true;
+}
+
+std::optional<Closure_t> SpawnDevice::pop(Machine &machine)
+{
+	if (auto locOpt = popLoc(machine))
+	{
+		return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(locOpt.value())));
+	}
+	return std::nullopt;
+}
+
+std::optional<Loc_t> SpawnDevice::popLoc(Machine &)
+{
+	if (m_Handles.empty())
+	{
+		return std::nullopt;
+	}
+
+	Loc_t loc = m_Handles.back();
+	m_Handles.pop_back();
+	return loc;
+}
+
+std::optional<Closure_t> ChanDevice::pop(Machine &machine)
+{
+	return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(popLoc(machine).value())));
+}
+
+std::optional<Loc_t> ChanDevice::popLoc(Machine &)
+{
+	auto [loc, channel] = Channel::create();
+	m_Channels.push_back(std::move(channel));
+	return loc;
+}
+
+ChannelDevice::ChannelDevice(std::shared_ptr<Channel> channel)
+	: m_Channel(std::move(channel))
+{}
+
+Channel &ChannelDevice::getChannel() const
+{
+	return *m_Channel;
+}
+
+bool ChannelDevice::push(Machine &machine, const Env_t &env, TermHandle_t term)
+{
+	term = resolveValue(env, term);
+	waitOutput(machine, m_Channel->canPush());
+
+	if (!term->isVal())
+	{
+		machine.error("Channels can only carry primitives & locations !");
+	}
+
+	const ValTerm &val = term->asVal();
+	if (val.isPrim())
+	{
+		return m_Channel->push(val.asPrim(), machine.getStopFlag());
+	}
+	return m_Channel->push(val.asLoc(), machine.getStopFlag());
+}
+
+bool ChannelDevice::pushLoc(Machine &machine, Loc_t loc)
+{
+	waitOutput(machine, m_Channel->canPush());
+	return m_Channel->push(loc, machine.getStopFlag());
+}
+
+std::optional<Closure_t> ChannelDevice::pop(Machine &machine)
+{
+	waitOutput(machine, m_Channel->canPop());
+	if (auto valueOpt = m_Channel->pop(machine.getStopFlag()))
+	{
+		TermHandle_t term = std::visit([&](auto value) { return machine.freshTerm(ValTerm(value)); }, valueOpt.value());
+		return std::make_pair(Env_t{}, term);
+	}
+	return std::nullopt;
+}
+
+std::optional<Loc_t> ChannelDevice::popLoc(Machine &machine)
+{
+	waitOutput(machine, m_Channel->canPop());
+	if (auto valueOpt = m_Channel->pop(machine.getStopFlag()))
+	{
+		if (const Loc_t *loc = std::get_if<Loc_t>(&valueOpt.value()))
+		{
+			return *loc;
+		}
+	}
+	return std::nullopt;
+}
+
+void ChannelDevice::waitOutput(Machine &machine, bool isReady)
+{
+	// Spawned machines park rather than block (and don't own the output)
+	if (!isReady && !machine.isSpawned())
+	{
+		machine.getOutput().poll(true);
+	}
+}
+
+bool ChannelDevice::canPush(const Machine &)
+{
+	return m_Channel->canPush();
+}
+
+bool ChannelDevice::canPop(const Machine &)
+{
+	return m_Channel->canPop();
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <optional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "Config.hpp"
+#include "Term.hpp"
+#include "Machine.hpp"
+#include "Printer.hpp"
+#include "Channel.hpp"
+
+// A location whose pushes & pops are handled by a device, rather than being a
+// stack in the machine's memory. Devices are added to a machine by name (see
+// 'Machine::addDevice') and found by location in a table, so any number of
+// them can be added without slowing down other locations.
+//
+// Handlers which the device doesn't support return false (or nothing), which
+// the machine reports as an error.
+class Device
+{
+public:
+	virtual ~Device() = default;
+
+	// Application '[M]l', where 'term' is 'M' & 'env' its environment
+	virtual bool push(Machine &machine, const Env_t &env, TermHandle_t term);
+	// Location application '[#a]l', where 'loc' is 'a'
+	virtual bool pushLoc(Machine &machine, Loc_t loc);
+
+	// Abstraction 'l<x>'
+	virtual std::optional<Closure_t> pop(Machine &machine);
+	// Location abstraction 'l<@x>'
+	virtual std::optional<Loc_t> popLoc(Machine &machine);
+
+	// Whether a push (or pop) would be handled without waiting, which is
+	// asked before each one when the machine is run in slices (true by default)
+	virtual bool canPush(const Machine &machine);
+	virtual bool canPop(const Machine &machine);
+};
+
+// 'new', popping a fresh location
+class NewDevice : public Device
+{
+public:
+	std::optional<Closure_t> pop(Machine &machine) override;
+	std::optional<Loc_t> popLoc(Machine &machine) override;
+};
+
+// 'in', popping the next word of the machine's input as a term
+class InputDevice : public Device
+{
+public:
+	std::optional<Closure_t> pop(Machine &machine) override;
+	bool canPop(const Machine &machine) override;
+
+protected:
+	// Parses the term, reporting an error if it isn't one
+	Closure_t parseTerm(Machine &machine, std::string_view source);
+
+private:
+	// Terms parsed from the input (deque so handles to them stay valid)
+	std::deque<TermArena> m_Terms;
+};
+
+// 'in' with '--io binary', popping the next frame of the machine's input
+class BinaryInputDevice : public InputDevice
+{
+public:
+	std::optional<Closure_t> pop(Machine &machine) override;
+	bool canPop(const Machine &machine) override;
+};
+
+// 'out', writing whatever is pushed to the machine's output
+class OutputDevice : public Device
+{
+public:
+	bool push(Machine &machine, const Env_t &env, TermHandle_t term) override;
+	bool pushLoc(Machine &machine, Loc_t loc) override;
+
+protected:
+	// Reused for every value printed
+	Printer m_Printer;
+	std::string m_Buffer;
+};
+
+// 'out' with '--io binary', writing whatever is pushed as a frame
+class BinaryOutputDevice : public OutputDevice
+{
+public:
+	bool push(Machine &machine, const Env_t &env, TermHandle_t term) override;
+	bool pushLoc(Machine &machine, Loc_t loc) override;
+};
+
+// 'null', discarding whatever is pushed
+class NullDevice : public Device
+{
+public:
+	bool push(Machine &machine, const Env_t &env, TermHandle_t term) override;
+	bool pushLoc(Machine &machine, Loc_t loc) override;
+};
+
+// 'spawn', running whatever is pushed on a child machine (see 'Machine::spawn'),
+// popping the location the last one pushed is joined to
+class SpawnDevice : public Device
+{
+public:
+	bool push(Machine &machine, const Env_t &env, TermHandle_t term) override;
+
+	std::optional<Closure_t> pop(Machine &machine) override;
+	std::optional<Loc_t> popLoc(Machine &machine) override;
+
+private:
+	std::vector<Loc_t> m_Handles;
+};
+
+// 'chan', popping the location of a new channel (see 'Channel'), which is kept
+// for as long as the device is
+class ChanDevice : public Device
+{
+public:
+	std::optional<Closure_t> pop(Machine &machine) override;
+	std::optional<Loc_t> popLoc(Machine &machine) override;
+
+private:
+	std::vector<std::shared_ptr<Channel>> m_Channels;
+};
+
+// Location of a channel, which the machine adds when the location is first
+// used (see 'Machine::getDevice'). Popping blocks until a value is pushed, from
+// this or any other machine (unless the machine is run in slices, which parks).
+class ChannelDevice : public Device
+{
+public:
+	explicit ChannelDevice(std::shared_ptr<Channel> channel);
+
+	Channel &getChannel() const;
+
+	bool push(Machine &machine, const Env_t &env, TermHandle_t term) override;
+	bool pushLoc(Machine &machine, Loc_t loc) override;
+
+	std::optional<Closure_t> pop(Machine &machine) override;
+	std::optional<Loc_t> popLoc(Machine &machine) override;
+
+	bool canPush(const Machine &machine) override;
+	bool canPop(const Machine &machine) override;
+
+private:
+	// Values held back by the time policy are written before blocking
+	static void waitOutput(Machine &machine, bool isReady);
+
+private:
+	std::shared_ptr<Channel> m_Channel;
+};
\ No newline at end of file
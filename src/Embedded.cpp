@@ -0,0 +1,123 @@
+#include "Embedded.hpp"
+
+#include <algorithm>
+
+#include "Fusion.hpp"
+
+static std::optional<Symbol_t> toOptional(std::string_view name)
+{
+	if (name.empty())
+	{
+		return std::nullopt;
+	}
+	return internSymbol(name);
+}
+
+static TermIdx_t buildTerm(TermArena &arena, const EmbeddedTerm *terms, uint32_t idx, bool fuse)
+{
+	const EmbeddedTerm &term = terms[idx];
+
+	auto buildBody = [&]() -> TermIdx_t {
+		return (term.Body != k_NoEmbeddedTerm) ? buildTerm(arena, terms, term.Body, fuse) : k_NilTermIdx;
+	};
+
+	// Cases are added consecutively (in order, later cases replacing earlier ones)
+	auto buildCases = [&](auto getCase, auto lessCase) -> std::pair<TermIdx_t, uint32_t> {
+		using Case_t = decltype(getCase(terms[0]));
+
+		std::vector<std::pair<Case_t, TermIdx_t>> cases;
+		for (uint32_t arm = term.Arms; arm != k_NoEmbeddedTerm; arm = terms[arm].Body)
+		{
+			Case_t value = getCase(terms[arm]);
+			TermIdx_t armTerm = buildTerm(arena, terms, terms[arm].Arg, fuse);
+
+			auto it = std::find_if(cases.begin(), cases.end(), [&](const auto &c) { return c.first == value; });
+			if (it != cases.end())
+			{
+				it->second = armTerm;
+			}
+			else
+			{
+				cases.emplace_back(value, armTerm);
+			}
+		}
+
+		std::sort(cases.begin(), cases.end(), [&](const auto &a, const auto &b) {
+			return lessCase(a.first, b.first);
+		});
+
+		std::vector<std::pair<ValTerm, TermIdx_t>> arms;
+		for (auto &c : cases)
+		{
+			arms.emplace_back(ValTerm(c.first), c.second);
+		}
+
+		uint32_t numCases = static_cast<uint32_t>(arms.size());
+		return {arena.addCases(std::move(arms)), numCases};
+	};
+
+	auto build = [&]() -> TermIdx_t {
+		switch (term.Type)
+		{
+		case EmbeddedTerm::Var:
+			return arena.add(Term(VarTerm(internSymbol(term.Name))), buildBody());
+		case EmbeddedTerm::Abs:
+			return arena.add(Term(AbsTerm(internSymbol(term.Loc), toOptional(term.Name))), buildBody());
+		case EmbeddedTerm::App:
+		{
+			TermIdx_t arg = buildTerm(arena, terms, term.Arg, fuse);
+			return arena.add(Term(AppTerm(internSymbol(term.Loc))), buildBody(), arg);
+		}
+		case EmbeddedTerm::LocAbs:
+			return arena.add(Term(LocAbsTerm(internSymbol(term.Loc), toOptional(term.Name))), buildBody());
+		case EmbeddedTerm::LocApp:
+			return arena.add(Term(LocAppTerm(internSymbol(term.Loc), internSymbol(term.Name))), buildBody());
+		case EmbeddedTerm::Val:
+			return arena.add(Term(ValTerm(term.Prim)));
+		case EmbeddedTerm::BinOp:
+			return arena.add(Term(BinOpTerm(term.Op)), buildBody());
+		case EmbeddedTerm::PrimCases:
+		{
+			TermIdx_t otherwise = buildTerm(arena, terms, term.Arg, fuse);
+			TermIdx_t body = buildBody();
+			auto [first, numCases] = buildCases(
+				[](const EmbeddedTerm &arm) { return arm.Prim; },
+				[](Prim_t a, Prim_t b) { return a < b; }
+			);
+			return arena.add(Term(CasesTerm<Prim_t>(numCases)), body, otherwise, first);
+		}
+		case EmbeddedTerm::LocCases:
+		{
+			TermIdx_t otherwise = buildTerm(arena, terms, term.Arg, fuse);
+			TermIdx_t body = buildBody();
+			auto [first, numCases] = buildCases(
+				[](const EmbeddedTerm &arm) { return internSymbol(arm.Loc); },
+				[](Loc_t a, Loc_t b) { return getSymbolName(a) < getSymbolName(b); }
+			);
+			return arena.add(Term(CasesTerm<Loc_t>(numCases)), body, otherwise, first);
+		}
+		default:
+			return arena.add(Term(NilTerm()));
+		}
+	};
+
+	if (fuse)
+	{
+		return fuseTerm(arena, build());
+	}
+
+	return build();
+}
+
+Program::FuncDefs_t buildEmbeddedFuncDefs(TermArena &arena,
+	const EmbeddedTerm *terms, const EmbeddedFunc *funcs, size_t numFuncs, bool fuse)
+{
+	Program::FuncDefs_t defs;
+
+	for (size_t i = 0; i < numFuncs; ++i)
+	{
+		defs[internSymbol(funcs[i].Name)] = buildTerm(arena, terms, funcs[i].Term, fuse);
+	}
+
+	return defs;
+}
\ No newline at end of file
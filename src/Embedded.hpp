@@ -0,0 +1,541 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <optional>
+#include <string_view>
+#include <algorithm>
+#include <cinttypes>
+
+#include "Config.hpp"
+#include "Lexer.hpp"
+#include "Term.hpp"
+#include "Program.hpp"
+
+// Programs embedded as string literals are lexed & parsed at compile time into
+// a static table of terms, e.g.
+//
+//   Program program = EmbeddedProgram<"main = ([0] . <x> . [x]out)">::load();
+//
+// Syntax errors in the source are reported as compile errors. The table holds
+// identifiers by name, as symbols are only numbered once interned at run time,
+// so 'load' builds the terms (into an arena, as the parser would) rather than
+// the machine executing the table in place.
+
+template<size_t N>
+struct EmbeddedSource
+{
+	constexpr EmbeddedSource(const char (&str)[N])
+	{
+		std::copy_n(str, N, Chars);
+	}
+
+	constexpr std::string_view view() const
+	{
+		return std::string_view(Chars, N - 1);
+	}
+
+	char Chars[N];
+};
+
+constexpr uint32_t k_NoEmbeddedTerm = UINT32_MAX;
+
+// Name of 'k_LambdaLoc', whilst parsing at compile time
+constexpr std::string_view k_EmbeddedLambdaLoc = k_ReservedLocIds[k_LambdaLoc];
+
+struct EmbeddedTerm
+{
+	enum Kind : uint8_t
+	{
+		Nil, Var, Abs, App, LocAbs, LocApp, Val, BinOp, PrimCases, LocCases, Arm
+	};
+
+	constexpr EmbeddedTerm(Kind type = Nil)
+		: Type(type)
+	{}
+
+	Kind Type = Nil;
+	std::string_view Loc;  // Location (or key of a location case)
+	std::string_view Name; // Variable, location variable or location argument, empty for '_'
+	Prim_t Prim = 0;       // Value (or key of a primitive case)
+	BinOpTerm::Op Op = BinOpTerm::Plus;
+
+	uint32_t Arg = k_NoEmbeddedTerm;  // Argument, arm of a case or 'otherwise' case of cases
+	uint32_t Body = k_NoEmbeddedTerm; // Body, or next case of a case
+	uint32_t Arms = k_NoEmbeddedTerm; // First case of cases
+};
+
+struct EmbeddedFunc
+{
+	std::string_view Name;
+	uint32_t Term;
+};
+
+// Not 'constexpr', so reaching this whilst parsing at compile time is a compile error
+inline void embeddedParseError(const char *message)
+{
+	(void)message;
+}
+
+class EmbeddedParser
+{
+public:
+	constexpr explicit EmbeddedParser(std::string_view source)
+		: m_Source(source)
+	{
+		parseFuncDefs();
+	}
+
+	constexpr const std::vector<EmbeddedTerm> &getTerms() const { return m_Terms; }
+	constexpr const std::vector<EmbeddedFunc> &getFuncs() const { return m_Funcs; }
+
+private:
+	struct Lexeme
+	{
+		Token Type;
+		std::string_view Buffer;
+		size_t End;
+	};
+
+	constexpr static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+	constexpr static bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+	constexpr static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	constexpr Lexeme lex(size_t pos) const
+	{
+		while (pos < m_Source.size() && isSpace(m_Source[pos]))
+		{
+			pos++;
+		}
+
+		if (pos >= m_Source.size())
+		{
+			return {Token::Eof, {}, pos};
+		}
+
+		char c = m_Source[pos];
+		auto single = [&](Token token) {
+			return Lexeme{token, m_Source.substr(pos, 1), pos + 1};
+		};
+
+		switch (c)
+		{
+		case '(': return single(Token::Lb);
+		case ')': return single(Token::Rb);
+		case '<': return single(Token::Lab);
+		case '>': return single(Token::Rab);
+		case '[': return single(Token::Lsb);
+		case ']': return single(Token::Rsb);
+		case '*': return single(Token::Asterisk);
+		case '.': return single(Token::Dot);
+		case '=': return single(Token::Equal);
+		case ',': return single(Token::Comma);
+		case '_': return single(Token::Underscore);
+		case '@': return single(Token::Ampersand);
+		case '#': return single(Token::Hash);
+		case '+': return single(Token::Plus);
+		case '-':
+			if (pos + 1 < m_Source.size() && m_Source[pos + 1] == '>')
+			{
+				return {Token::Arrow, m_Source.substr(pos, 2), pos + 2};
+			}
+			return single(Token::Minus);
+		default:
+			break;
+		}
+
+		size_t end = pos + 1;
+
+		if (isAlpha(c))
+		{
+			while (end < m_Source.size())
+			{
+				if (isAlpha(m_Source[end]) || isDigit(m_Source[end]) || m_Source[end] == '_')
+				{
+					end++;
+				}
+				// Identifiers qualified by a module, i.e. 'module::name' (as 'Lexer')
+				else if (end + 2 < m_Source.size() && m_Source[end] == ':' && m_Source[end + 1] == ':'
+					&& isAlpha(m_Source[end + 2]))
+				{
+					end += 3;
+				}
+				else
+				{
+					break;
+				}
+			}
+			return {Token::Id, m_Source.substr(pos, end - pos), end};
+		}
+		else if (isDigit(c))
+		{
+			while (end < m_Source.size() && isDigit(m_Source[end]))
+			{
+				end++;
+			}
+			return {Token::Primitive, m_Source.substr(pos, end - pos), end};
+		}
+
+		embeddedParseError("Unexpected character");
+		return {Token::Eof, {}, pos};
+	}
+
+	constexpr Lexeme peek(size_t n = 0) const
+	{
+		Lexeme lexeme = lex(m_Pos);
+		for (size_t i = 0; i < n; ++i)
+		{
+			lexeme = lex(lexeme.End);
+		}
+		return lexeme;
+	}
+
+	constexpr bool isPeek(Token token, size_t n = 0) const
+	{
+		return peek(n).Type == token;
+	}
+
+	constexpr std::string_view next()
+	{
+		Lexeme lexeme = peek();
+		m_Pos = lexeme.End;
+		return lexeme.Buffer;
+	}
+
+	constexpr static Prim_t toPrim(std::string_view digits)
+	{
+		int64_t prim = 0;
+		for (char c : digits)
+		{
+			prim = prim * 10 + (c - '0');
+			if (prim > INT32_MAX)
+			{
+				embeddedParseError("Primitive is out of range");
+			}
+		}
+		return static_cast<Prim_t>(prim);
+	}
+
+	constexpr uint32_t add(EmbeddedTerm term)
+	{
+		m_Terms.push_back(term);
+		return static_cast<uint32_t>(m_Terms.size() - 1);
+	}
+
+	// Parses the optional '. term' after a term into its body
+	constexpr uint32_t addWithBody(EmbeddedTerm term, const char *error)
+	{
+		uint32_t idx = add(term);
+
+		if (isPeek(Token::Dot))
+		{
+			next();
+
+			uint32_t body = parseTerm();
+			if (body == k_NoEmbeddedTerm)
+			{
+				embeddedParseError(error);
+			}
+			m_Terms[idx].Body = body;
+		}
+
+		return idx;
+	}
+
+	constexpr void parseFuncDefs()
+	{
+		while (!isPeek(Token::Eof))
+		{
+			if (!isPeek(Token::Id))
+			{
+				embeddedParseError("Expected function declaration");
+				return;
+			}
+
+			std::string_view name = next();
+
+			if (!isPeek(Token::Equal))
+			{
+				embeddedParseError("Expected '=' after declaration of function");
+			}
+			next();
+
+			if (!isPeek(Token::Lb))
+			{
+				embeddedParseError("Expected '(' before definition of function");
+			}
+			next();
+
+			uint32_t term = parseTerm();
+			if (term == k_NoEmbeddedTerm)
+			{
+				embeddedParseError("Expected term for definition of function");
+			}
+
+			if (!isPeek(Token::Rb))
+			{
+				embeddedParseError("Expected ')' after definition of function");
+			}
+			next();
+
+			m_Funcs.push_back({name, term});
+		}
+	}
+
+	constexpr uint32_t parseTerm()
+	{
+		// Variable
+		if (isPeek(Token::Asterisk))
+		{
+			next();
+			return add({EmbeddedTerm::Nil});
+		}
+		else if (isPeek(Token::Id) && isPeek(Token::Dot, 1))
+		{
+			EmbeddedTerm var{EmbeddedTerm::Var};
+			var.Name = next();
+			return addWithBody(var, "Expected term after variable");
+		}
+		else if (isPeek(Token::Id) &&
+			(isPeek(Token::Comma, 1) || isPeek(Token::Rsb, 1) || isPeek(Token::Rb, 1) || isPeek(Token::Eof, 1)))
+		{
+			EmbeddedTerm var{EmbeddedTerm::Var};
+			var.Name = next();
+			return add(var);
+		}
+		// Abstraction & location abstraction
+		else if ((isPeek(Token::Id) && isPeek(Token::Lab, 1)) || isPeek(Token::Lab))
+		{
+			std::string_view loc = k_EmbeddedLambdaLoc;
+			if (isPeek(Token::Id))
+			{
+				loc = next();
+			}
+			next();
+
+			EmbeddedTerm abs{EmbeddedTerm::Abs};
+			if (isPeek(Token::Ampersand))
+			{
+				abs.Type = EmbeddedTerm::LocAbs;
+				next();
+			}
+			abs.Loc = loc;
+
+			if (isPeek(Token::Id))
+			{
+				abs.Name = next();
+			}
+			else if (isPeek(Token::Underscore))
+			{
+				next();
+			}
+			else
+			{
+				embeddedParseError("Expected binding variable of abstraction");
+			}
+
+			if (!isPeek(Token::Rab))
+			{
+				embeddedParseError("Expected closing '>' of abstraction");
+			}
+			next();
+
+			return addWithBody(abs, "Expected term after abstraction");
+		}
+		// Location application
+		else if (isPeek(Token::Lsb) && isPeek(Token::Hash, 1))
+		{
+			next();
+			next();
+
+			EmbeddedTerm locApp{EmbeddedTerm::LocApp};
+			if (!isPeek(Token::Id))
+			{
+				embeddedParseError("Expected inner term of application");
+			}
+			locApp.Name = next();
+
+			if (!isPeek(Token::Rsb))
+			{
+				embeddedParseError("Expected closing ']' of application");
+			}
+			next();
+
+			locApp.Loc = isPeek(Token::Id) ? next() : k_EmbeddedLambdaLoc;
+			return addWithBody(locApp, "Expected term after application");
+		}
+		// Application
+		else if (isPeek(Token::Lsb))
+		{
+			next();
+
+			EmbeddedTerm app{EmbeddedTerm::App};
+			app.Arg = parseTerm();
+			if (app.Arg == k_NoEmbeddedTerm)
+			{
+				embeddedParseError("Expected inner term of application");
+			}
+
+			if (!isPeek(Token::Rsb))
+			{
+				embeddedParseError("Expected closing ']' of application");
+			}
+			next();
+
+			app.Loc = isPeek(Token::Id) ? next() : k_EmbeddedLambdaLoc;
+			return addWithBody(app, "Expected term after application");
+		}
+		// Value
+		else if (isPeek(Token::Primitive))
+		{
+			EmbeddedTerm val{EmbeddedTerm::Val};
+			val.Prim = toPrim(next());
+			return add(val);
+		}
+		// Binary operation
+		else if (isPeek(Token::Plus) || isPeek(Token::Minus))
+		{
+			EmbeddedTerm binOp{EmbeddedTerm::BinOp};
+			binOp.Op = isPeek(Token::Plus) ? BinOpTerm::Plus : BinOpTerm::Minus;
+			next();
+			return addWithBody(binOp, "Expected term after binary operation");
+		}
+		// Cases
+		else if (isPeek(Token::Lb))
+		{
+			next();
+			return parseCases();
+		}
+
+		return k_NoEmbeddedTerm;
+	}
+
+	constexpr uint32_t parseCases()
+	{
+		EmbeddedTerm cases{EmbeddedTerm::PrimCases};
+		uint32_t lastArm = k_NoEmbeddedTerm;
+		bool hasPrimCases = false;
+		bool hasLocCases = false;
+
+		do
+		{
+			EmbeddedTerm arm{EmbeddedTerm::Arm};
+			bool isOtherwise = false;
+
+			if (isPeek(Token::Primitive))
+			{
+				arm.Prim = toPrim(next());
+				hasPrimCases = true;
+			}
+			else if (isPeek(Token::Id))
+			{
+				arm.Loc = next();
+				isOtherwise = (arm.Loc == "otherwise");
+				hasLocCases |= !isOtherwise;
+			}
+			else
+			{
+				embeddedParseError("Expected a case for cases");
+			}
+
+			if (!isPeek(Token::Arrow))
+			{
+				embeddedParseError("Expected '->' after case");
+			}
+			next();
+
+			arm.Arg = parseTerm();
+			if (arm.Arg == k_NoEmbeddedTerm)
+			{
+				embeddedParseError("Expected mapping term for case");
+			}
+
+			if (isOtherwise)
+			{
+				cases.Arg = arm.Arg;
+			}
+			else
+			{
+				uint32_t armIdx = add(arm);
+				if (lastArm == k_NoEmbeddedTerm)
+				{
+					cases.Arms = armIdx;
+				}
+				else
+				{
+					m_Terms[lastArm].Body = armIdx;
+				}
+				lastArm = armIdx;
+			}
+		} while (isPeek(Token::Comma) && (next(), true));
+
+		if (!isPeek(Token::Rb))
+		{
+			return k_NoEmbeddedTerm;
+		}
+		next();
+
+		if (cases.Arg == k_NoEmbeddedTerm)
+		{
+			embeddedParseError("Required an 'otherwise' case for cases");
+		}
+		if (hasPrimCases == hasLocCases)
+		{
+			embeddedParseError("Expected either primitive or location cases");
+		}
+
+		cases.Type = hasPrimCases ? EmbeddedTerm::PrimCases : EmbeddedTerm::LocCases;
+		return addWithBody(cases, "Expected term after cases");
+	}
+
+private:
+	std::string_view m_Source;
+	size_t m_Pos = 0;
+
+	std::vector<EmbeddedTerm> m_Terms;
+	std::vector<EmbeddedFunc> m_Funcs;
+};
+
+// Builds the definitions of a program from its table (into 'arena'), without lexing or parsing
+Program::FuncDefs_t buildEmbeddedFuncDefs(TermArena &arena,
+	const EmbeddedTerm *terms, const EmbeddedFunc *funcs, size_t numFuncs, bool fuse = true
+);
+
+template<EmbeddedSource Source>
+class EmbeddedProgram
+{
+private:
+	static constexpr size_t s_NumTerms = EmbeddedParser(Source.view()).getTerms().size();
+	static constexpr size_t s_NumFuncs = EmbeddedParser(Source.view()).getFuncs().size();
+
+	struct Table
+	{
+		std::array<EmbeddedTerm, s_NumTerms> Terms;
+		std::array<EmbeddedFunc, s_NumFuncs> Funcs;
+	};
+
+	static constexpr Table makeTable()
+	{
+		EmbeddedParser parser(Source.view());
+
+		Table table{};
+		std::copy(parser.getTerms().begin(), parser.getTerms().end(), table.Terms.begin());
+		std::copy(parser.getFuncs().begin(), parser.getFuncs().end(), table.Funcs.begin());
+		return table;
+	}
+
+public:
+	static constexpr Table s_Table = makeTable();
+
+	static Program load(bool fuse = true)
+	{
+		TermArena arena;
+		arena.reserve(s_NumTerms + 1);
+
+		Program::FuncDefs_t funcs = buildEmbeddedFuncDefs(arena,
+			s_Table.Terms.data(), s_Table.Funcs.data(), s_NumFuncs, fuse
+		);
+
+		return Program(std::move(arena), std::move(funcs));
+	}
+};
\ No newline at end of file
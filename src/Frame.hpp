@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+// Binary wire format of 'in' & 'out' (with '--io binary'), so values can be
+// streamed between machines without being printed & parsed again. Each value
+// is a frame of a one byte tag, the size of the payload as a 32-bit integer
+// (in the native byte order) & then the payload.
+enum class FrameTag : uint8_t
+{
+	Prim = 1, // 32-bit integer
+	Loc  = 2, // Name of the location
+	Term = 3  // Source of the term (closures are printed with their bindings)
+};
+
+constexpr size_t k_FrameHeaderSize = 1 + sizeof(uint32_t);
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "Fusion.hpp"
+
+static bool isBareVar(TermHandle_t term, std::optional<Var_t> var = std::nullopt)
+{
+	if (term->isVar() && term->getBody()->isNil())
+	{
+		return !var || term->asVar().getVar() == var.value();
+	}
+
+	return false;
+}
+
+// [x] . [y] . op
+static std::optional<TermIdx_t> tryFuseBinOpVars(TermArena &arena, TermIdx_t idx)
+{
+	TermHandle_t first = arena.get(idx);
+
+	if (!first->isApp())
+	{
+		return std::nullopt;
+	}
+
+	TermHandle_t second = first->getBody();
+
+	if (first->asApp().getLoc() != k_LambdaLoc || !isBareVar(first->getArg()) || !second->isApp())
+	{
+		return std::nullopt;
+	}
+
+	TermHandle_t third = second->getBody();
+
+	if (second->asApp().getLoc() != k_LambdaLoc || !isBareVar(second->getArg()) || !third->isBinOp())
+	{
+		return std::nullopt;
+	}
+
+	BinOpTerm::Op op = third->asBinOp().isOp(BinOpTerm::Plus) ? BinOpTerm::Plus : BinOpTerm::Minus;
+
+	Var_t lhs = first->getArg()->asVar().getVar();
+	Var_t rhs = second->getArg()->asVar().getVar();
+	TermIdx_t body = arena.getIdx(third->getBody());
+
+	return arena.add(Term(BinOpVarsTerm(lhs, rhs, op)), body, idx);
+}
+
+// l<x> . l<@y> . [#y]l . [x]l
+static std::optional<TermIdx_t> tryFusePeekPair(TermArena &arena, TermIdx_t idx)
+{
+	TermHandle_t first = arena.get(idx);
+
+	if (!first->isAbs() || !first->asAbs().getVar())
+	{
+		return std::nullopt;
+	}
+
+	const AbsTerm &abs = first->asAbs();
+	Loc_t loc = abs.getLoc();
+	Var_t var = abs.getVar().value();
+	TermHandle_t second = first->getBody();
+
+	if (!second->isLocAbs() || !second->asLocAbs().getLocVar())
+	{
+		return std::nullopt;
+	}
+
+	const LocAbsTerm &locAbs = second->asLocAbs();
+	LocVar_t locVar = locAbs.getLocVar().value();
+	TermHandle_t third = second->getBody();
+
+	// Rebinding the peeked location itself would change what 'l' refers to
+	if (locAbs.getLoc() != loc || locVar == loc || !third->isLocApp())
+	{
+		return std::nullopt;
+	}
+
+	const LocAppTerm &locApp = third->asLocApp();
+	TermHandle_t fourth = third->getBody();
+
+	if (locApp.getLoc() != loc || locApp.getArg() != locVar || !fourth->isApp())
+	{
+		return std::nullopt;
+	}
+
+	if (fourth->asApp().getLoc() != loc || !isBareVar(fourth->getArg(), var))
+	{
+		return std::nullopt;
+	}
+
+	TermIdx_t body = arena.getIdx(fourth->getBody());
+
+	return arena.add(Term(PeekPairTerm(loc, var, locVar)), body, idx);
+}
+
+// l<x> . [x]k
+static std::optional<TermIdx_t> tryFuseMove(TermArena &arena, TermIdx_t idx)
+{
+	TermHandle_t first = arena.get(idx);
+
+	if (!first->isAbs() || !first->asAbs().getVar())
+	{
+		return std::nullopt;
+	}
+
+	Var_t var = first->asAbs().getVar().value();
+	TermHandle_t second = first->getBody();
+
+	if (!second->isApp() || !isBareVar(second->getArg(), var))
+	{
+		return std::nullopt;
+	}
+
+	Loc_t srcLoc = first->asAbs().getLoc();
+	Loc_t dstLoc = second->asApp().getLoc();
+	TermIdx_t body = arena.getIdx(second->getBody());
+
+	return arena.add(Term(MoveTerm(srcLoc, var, dstLoc)), body, idx);
+}
+
+TermIdx_t fuseTerm(TermArena &arena, TermIdx_t idx)
+{
+	if (auto fusedOpt = tryFuseBinOpVars(arena, idx))
+	{
+		return fusedOpt.value();
+	}
+	else if (auto fusedOpt = tryFusePeekPair(arena, idx))
+	{
+		return fusedOpt.value();
+	}
+	else if (auto fusedOpt = tryFuseMove(arena, idx))
+	{
+		return fusedOpt.value();
+	}
+
+	return idx;
+}
\ No newline at end of file
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "Term.hpp"
+
+// Adds a superinstruction for the term if it begins with a recognised
+// sequence, otherwise returns the index of the term untouched.
+TermIdx_t fuseTerm(TermArena &arena, TermIdx_t idx);
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "Host.hpp"
+
+HostFunc::HostFunc(std::vector<Loc_t> &&argLocs, std::vector<Loc_t> &&resultLocs, Func_t &&func)
+	: m_ArgLocs(std::move(argLocs))
+	, m_ResultLocs(std::move(resultLocs))
+	, m_Func(std::move(func))
+{}
+
+const std::vector<Loc_t> &HostFunc::getArgLocs() const
+{
+	return m_ArgLocs;
+}
+
+const std::vector<Loc_t> &HostFunc::getResultLocs() const
+{
+	return m_ResultLocs;
+}
+
+void HostFunc::call(std::span<const Prim_t> args, std::span<Prim_t> results) const
+{
+	m_Func(args, results);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "Config.hpp"
+
+// A native function which programs call by name (taking precedence over any
+// definition of the same name), see 'Program::addHostFunc'. e.g.
+//
+//   program.addHostFunc("multiply", HostFunc({k_LambdaLoc, k_LambdaLoc}, {k_LambdaLoc},
+//       [](std::span<const Prim_t> args, std::span<Prim_t> results) {
+//           results[0] = args[0] * args[1];
+//       }));
+//
+// Its arguments are popped as primitives from their locations (in order, so
+// the first is the top of its stack) and its results are pushed to theirs (in
+// order, so the last ends up on top). When an argument isn't a primitive, the
+// definition of the same name is run instead (if there is one).
+class HostFunc
+{
+public:
+	using Func_t = std::function<void(std::span<const Prim_t> args, std::span<Prim_t> results)>;
+
+public:
+	HostFunc(std::vector<Loc_t> &&argLocs, std::vector<Loc_t> &&resultLocs, Func_t &&func);
+
+	const std::vector<Loc_t> &getArgLocs() const;
+	const std::vector<Loc_t> &getResultLocs() const;
+
+	void call(std::span<const Prim_t> args, std::span<Prim_t> results) const;
+
+private:
+	std::vector<Loc_t> m_ArgLocs;
+	std::vector<Loc_t> m_ResultLocs;
+	Func_t m_Func;
+};
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include "Image.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <type_traits>
+
+#include "Symbol.hpp"
+
+// Terms are read straight out of the mapping, so must be plain bytes
+static_assert(std::is_trivially_copyable_v<Term>);
+
+// Layout of an image:
+//   header
+//   symbols (from the first after the reserved ones) as length & characters
+//   definitions as symbol & term index
+//   imported modules as symbols
+//   terms, aligned to 's_TermsAlignment'
+struct ImageHeader
+{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t TermSize;
+	uint64_t BuildId;
+	uint64_t SourceHash;
+	// Of everything following the header
+	uint64_t Checksum;
+
+	uint32_t NumSymbols;
+	uint32_t NumFuncs;
+	uint32_t NumImports;
+	uint64_t NumTerms;
+
+	uint64_t SymbolsOffset;
+	uint64_t FuncsOffset;
+	uint64_t ImportsOffset;
+	uint64_t TermsOffset;
+	uint64_t Size;
+};
+
+static constexpr char s_Magic[8] = { 'C', 'F', 'M', 'C', 'I', 'M', 'G', '\0' };
+
+// Bumped whenever the layout of an image changes
+static constexpr uint32_t s_Version = 2;
+
+static constexpr size_t s_TermsAlignment = 64;
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size)
+{
+	// FNV-1a
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+static constexpr uint64_t s_HashBasis = 0xcbf29ce484222325;
+
+// The layout of terms can change with any build, so images are tied to the one
+// which wrote them
+static uint64_t getBuildId()
+{
+	static const uint64_t buildId = []() {
+		std::string_view build = __DATE__ " " __TIME__;
+		uint64_t hash = hashBytes(s_HashBasis, build.data(), build.size());
+
+		uint64_t layout[] = { s_Version, sizeof(Term), alignof(Term), Term::s_NumKinds };
+		return hashBytes(hash, layout, sizeof(layout));
+	}();
+
+	return buildId;
+}
+
+template<typename T>
+static void writeValue(std::string &buffer, const T &value)
+{
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool readValue(std::string_view buffer, size_t &pos, T &value)
+{
+	if (buffer.size() < sizeof(T) || pos > buffer.size() - sizeof(T))
+	{
+		return false;
+	}
+
+	std::memcpy(&value, buffer.data() + pos, sizeof(T));
+	pos += sizeof(T);
+	return true;
+}
+
+Image::Image(MappedFile &&file)
+	: m_File(std::move(file))
+{}
+
+bool Image::write(const std::string &path, uint64_t sourceHash,
+	const Term *terms, size_t numTerms, const FuncDefs_t &funcs, const Imports_t &imports)
+{
+	std::string buffer(sizeof(ImageHeader), '\0');
+
+	ImageHeader header = {};
+	std::memcpy(header.Magic, s_Magic, sizeof(s_Magic));
+	header.Version = s_Version;
+	header.TermSize = sizeof(Term);
+	header.BuildId = getBuildId();
+	header.SourceHash = sourceHash;
+
+	header.SymbolsOffset = buffer.size();
+	header.NumSymbols = static_cast<uint32_t>(getNumSymbols());
+	for (Symbol_t symbol = k_NumReservedLocs; symbol < header.NumSymbols; ++symbol)
+	{
+		const std::string &name = getSymbolName(symbol);
+		writeValue(buffer, static_cast<uint32_t>(name.size()));
+		buffer += name;
+	}
+
+	header.FuncsOffset = buffer.size();
+	header.NumFuncs = static_cast<uint32_t>(funcs.size());
+	for (auto itFuncs = funcs.begin(); itFuncs != funcs.end(); ++itFuncs)
+	{
+		writeValue(buffer, itFuncs->first);
+		writeValue(buffer, itFuncs->second);
+	}
+
+	header.ImportsOffset = buffer.size();
+	header.NumImports = static_cast<uint32_t>(imports.size());
+	for (Symbol_t import : imports)
+	{
+		writeValue(buffer, import);
+	}
+
+	buffer.resize((buffer.size() + s_TermsAlignment - 1) / s_TermsAlignment * s_TermsAlignment, '\0');
+
+	header.TermsOffset = buffer.size();
+	header.NumTerms = numTerms;
+	buffer.append(reinterpret_cast<const char *>(terms), numTerms * sizeof(Term));
+
+	header.Size = buffer.size();
+	header.Checksum = hashBytes(s_HashBasis, buffer.data() + sizeof(ImageHeader), buffer.size() - sizeof(ImageHeader));
+	std::memcpy(buffer.data(), &header, sizeof(ImageHeader));
+
+	// Written beside the image & then renamed, so a reader never sees part of one
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file.write(buffer.data(), buffer.size()))
+		{
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	return !error;
+}
+
+std::optional<Image> Image::open(MappedFile &&file, std::optional<uint64_t> sourceHash)
+{
+	std::string_view buffer = file.getView();
+
+	if (!isImage(buffer) || buffer.size() < sizeof(ImageHeader))
+	{
+		return std::nullopt;
+	}
+
+	ImageHeader header;
+	std::memcpy(&header, buffer.data(), sizeof(ImageHeader));
+
+	if (header.Version != s_Version || header.TermSize != sizeof(Term) || header.BuildId != getBuildId())
+	{
+		return std::nullopt;
+	}
+	if (sourceHash && header.SourceHash != sourceHash.value())
+	{
+		return std::nullopt;
+	}
+
+	if (header.Size != buffer.size()
+		|| header.TermsOffset % s_TermsAlignment != 0
+		|| header.TermsOffset > buffer.size()
+		|| header.NumTerms == 0
+		|| header.NumTerms > (buffer.size() - header.TermsOffset) / sizeof(Term))
+	{
+		return std::nullopt;
+	}
+
+	if (header.Checksum != hashBytes(s_HashBasis, buffer.data() + sizeof(ImageHeader), buffer.size() - sizeof(ImageHeader)))
+	{
+		return std::nullopt;
+	}
+
+	// Identifiers are interned in the order they were written, so are usually
+	// the same symbols, unless something else was interned first
+	std::vector<Symbol_t> symbols(header.NumSymbols);
+	bool isRemapped = false;
+
+	size_t pos = header.SymbolsOffset;
+	for (Symbol_t symbol = 0; symbol < header.NumSymbols; ++symbol)
+	{
+		if (symbol < k_NumReservedLocs)
+		{
+			symbols[symbol] = symbol;
+			continue;
+		}
+
+		uint32_t size = 0;
+		if (!readValue(buffer, pos, size) || size > buffer.size() - pos)
+		{
+			return std::nullopt;
+		}
+
+		symbols[symbol] = internSymbol(buffer.substr(pos, size));
+		isRemapped |= (symbols[symbol] != symbol);
+		pos += size;
+	}
+
+	auto remap = [&](Symbol_t symbol) {
+		return (symbol < symbols.size()) ? symbols[symbol] : symbol;
+	};
+
+	Image image(std::move(file));
+	buffer = image.m_File.getView();
+
+	pos = header.FuncsOffset;
+	for (uint32_t i = 0; i < header.NumFuncs; ++i)
+	{
+		Var_t funcName = k_NoSymbol;
+		TermIdx_t funcIdx = k_NoTermIdx;
+		if (!readValue(buffer, pos, funcName) || !readValue(buffer, pos, funcIdx) || funcIdx >= header.NumTerms)
+		{
+			return std::nullopt;
+		}
+
+		image.m_Funcs[remap(funcName)] = funcIdx;
+	}
+
+	pos = header.ImportsOffset;
+	for (uint32_t i = 0; i < header.NumImports; ++i)
+	{
+		Symbol_t import = k_NoSymbol;
+		if (!readValue(buffer, pos, import))
+		{
+			return std::nullopt;
+		}
+
+		image.m_Imports.push_back(remap(import));
+	}
+
+	image.m_Terms = reinterpret_cast<const Term *>(buffer.data() + header.TermsOffset);
+	image.m_NumTerms = header.NumTerms;
+
+	if (isRemapped)
+	{
+		image.m_RemappedTerms.resize(image.m_NumTerms);
+		std::memcpy(static_cast<void *>(image.m_RemappedTerms.data()), image.m_Terms, image.m_NumTerms * sizeof(Term));
+
+		for (Term &term : image.m_RemappedTerms)
+		{
+			term.remapSymbols(symbols);
+		}
+
+		image.m_Terms = image.m_RemappedTerms.data();
+	}
+
+	return image;
+}
+
+std::optional<Image> Image::open(const std::string &path, std::optional<uint64_t> sourceHash)
+{
+	if (auto fileOpt = MappedFile::open(path))
+	{
+		return open(std::move(fileOpt.value()), sourceHash);
+	}
+	return std::nullopt;
+}
+
+bool Image::isImage(std::string_view buffer)
+{
+	return buffer.size() >= sizeof(s_Magic) && std::memcmp(buffer.data(), s_Magic, sizeof(s_Magic)) == 0;
+}
+
+uint64_t Image::hashSource(std::string_view source, bool isFusionEnabled, std::string_view moduleName)
+{
+	uint64_t hash = hashBytes(s_HashBasis, source.data(), source.size());
+	hash = hashBytes(hash, moduleName.data(), moduleName.size());
+
+	uint64_t options[] = { getBuildId(), isFusionEnabled };
+	return hashBytes(hash, options, sizeof(options));
+}
+
+std::string Image::getCachePath(const std::string &cacheDir, uint64_t sourceHash)
+{
+	std::error_code error;
+	std::filesystem::create_directories(cacheDir, error);
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.fmci", static_cast<unsigned long long>(sourceHash));
+
+	return (std::filesystem::path(cacheDir) / name).string();
+}
+
+const Term *Image::getTerms() const
+{
+	return m_Terms;
+}
+
+size_t Image::getNumTerms() const
+{
+	return m_NumTerms;
+}
+
+const Image::FuncDefs_t &Image::getFuncDefs() const
+{
+	return m_Funcs;
+}
+
+const Image::Imports_t &Image::getImports() const
+{
+	return m_Imports;
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "Config.hpp"
+#include "Term.hpp"
+#include "MappedFile.hpp"
+
+// Binary image of a parsed (and fused) program, which is mapped into memory and
+// executed in place, so loading it needs neither the lexer nor the parser.
+//
+// The terms are stored exactly as they're laid out in memory, so an image is
+// only valid for the build which wrote it. Its identifiers are re-interned
+// when it's loaded, and when they're numbered differently (as for a module
+// loaded after the program importing it) the terms are copied & renumbered.
+class Image
+{
+public:
+	using FuncDefs_t = std::unordered_map<Var_t, TermIdx_t>;
+	using Imports_t = std::vector<Symbol_t>;
+
+public:
+	Image(const Image &image) = delete;
+	Image(Image &&image) = default;
+
+	Image &operator=(const Image &image) = delete;
+	Image &operator=(Image &&image) = default;
+
+	// Writes the image atomically (replacing any existing one), 'funcs' being
+	// indices of the definitions within 'terms'
+	static bool write(const std::string &path, uint64_t sourceHash,
+		const Term *terms, size_t numTerms, const FuncDefs_t &funcs, const Imports_t &imports);
+
+	// Nothing if the image is truncated, corrupted, was written by another
+	// build, or (when given) wasn't compiled from a source with 'sourceHash'
+	static std::optional<Image> open(MappedFile &&file, std::optional<uint64_t> sourceHash = std::nullopt);
+	static std::optional<Image> open(const std::string &path, std::optional<uint64_t> sourceHash = std::nullopt);
+
+	static bool isImage(std::string_view buffer);
+
+	// Hash of the source, the options it was parsed with & the build, which
+	// keys its image in a cache directory. Modules are also keyed by name, as
+	// their definitions are named after it.
+	static uint64_t hashSource(std::string_view source, bool isFusionEnabled, std::string_view moduleName = {});
+
+	// Path of the image for a source within a cache directory (which is created)
+	static std::string getCachePath(const std::string &cacheDir, uint64_t sourceHash);
+
+	const Term *getTerms() const;
+	size_t getNumTerms() const;
+	const FuncDefs_t &getFuncDefs() const;
+	const Imports_t &getImports() const;
+
+private:
+	Image(MappedFile &&file);
+
+private:
+	MappedFile m_File;
+
+	const Term *m_Terms = nullptr;
+	size_t m_NumTerms = 0;
+	FuncDefs_t m_Funcs;
+	Imports_t m_Imports;
+
+	// Renumbered copy of the terms, if their symbols differed
+	std::vector<Term> m_RemappedTerms;
+};
\ No newline at end of file
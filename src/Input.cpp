@@ -0,0 +1,203 @@
+#include "Input.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#define read _read
+#define fileno _fileno
+#else
+#include <unistd.h>
+#include <poll.h>
+#endif
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+InputSource::InputSource(std::FILE *file)
+	: m_Fd(fileno(file))
+	, m_Buffer(s_BlockSize)
+	, m_Data(m_Buffer.data())
+{}
+
+InputSource::InputSource(MappedFile &&file)
+	: m_File(std::move(file))
+{
+	std::string_view view = m_File->getView();
+	m_Data = view.data();
+	m_End = view.size();
+}
+
+InputSource::InputSource(std::string_view str)
+	: m_Data(str.data())
+	, m_End(str.size())
+{}
+
+std::optional<std::string_view> InputSource::nextWord()
+{
+	size_t keep = m_Pos;
+
+	while (true)
+	{
+		while (m_Pos < m_End && isSpace(m_Data[m_Pos]))
+		{
+			m_Pos++;
+		}
+
+		keep = m_Pos;
+		if (m_Pos < m_End || !fill(keep))
+		{
+			break;
+		}
+		m_Pos = keep;
+	}
+
+	if (m_Pos >= m_End)
+	{
+		return std::nullopt;
+	}
+
+	// The word may continue past what's been read so far
+	size_t begin = m_Pos;
+
+	while (true)
+	{
+		while (m_Pos < m_End && !isSpace(m_Data[m_Pos]))
+		{
+			m_Pos++;
+		}
+
+		if (m_Pos < m_End)
+		{
+			break;
+		}
+
+		size_t length = m_Pos - begin;
+		if (!fill(begin))
+		{
+			break;
+		}
+		m_Pos = begin + length;
+	}
+
+	return std::string_view(m_Data + begin, m_Pos - begin);
+}
+
+std::optional<std::pair<FrameTag, std::string_view>> InputSource::nextFrame()
+{
+	if (!require(k_FrameHeaderSize))
+	{
+		return std::nullopt;
+	}
+
+	FrameTag tag = static_cast<FrameTag>(m_Data[m_Pos]);
+	uint32_t size;
+	std::memcpy(&size, m_Data + m_Pos + 1, sizeof(size));
+
+	if (!require(k_FrameHeaderSize + size))
+	{
+		return std::nullopt;
+	}
+
+	std::string_view payload(m_Data + m_Pos + k_FrameHeaderSize, size);
+	m_Pos += k_FrameHeaderSize + size;
+
+	return std::make_pair(tag, payload);
+}
+
+bool InputSource::isWordReady()
+{
+	// A whole word may already have been read
+	const char *begin = m_Data + m_Pos;
+	const char *end = m_Data + m_End;
+
+	const char *word = std::find_if(begin, end, [](char c) { return !isSpace(c); });
+	return std::find_if(word, end, isSpace) != end || canFill();
+}
+
+bool InputSource::isFrameReady()
+{
+	// A whole frame may already have been read
+	if (m_End - m_Pos >= k_FrameHeaderSize)
+	{
+		uint32_t size;
+		std::memcpy(&size, m_Data + m_Pos + 1, sizeof(size));
+
+		if (m_End - m_Pos >= k_FrameHeaderSize + size)
+		{
+			return true;
+		}
+	}
+	return canFill();
+}
+
+InputSource &InputSource::getStdin()
+{
+	static InputSource source(stdin);
+	return source;
+}
+
+bool InputSource::fill(size_t &keep)
+{
+	// Mapped files (and strings) are read in full
+	if (m_Fd < 0)
+	{
+		return false;
+	}
+
+	size_t numKept = m_End - keep;
+	std::memmove(m_Buffer.data(), m_Buffer.data() + keep, numKept);
+	keep = 0;
+	m_End = numKept;
+
+	// Words longer than the buffer grow it
+	if (m_Buffer.size() - m_End < s_BlockSize / 2)
+	{
+		m_Buffer.resize(m_Buffer.size() * 2);
+	}
+	m_Data = m_Buffer.data();
+
+	// Whatever is available is returned (i.e. a line from a terminal)
+	auto numRead = read(m_Fd, m_Buffer.data() + m_End, static_cast<unsigned int>(m_Buffer.size() - m_End));
+	if (numRead <= 0)
+	{
+		return false;
+	}
+
+	m_End += static_cast<size_t>(numRead);
+	return true;
+}
+
+bool InputSource::canFill() const
+{
+	// Mapped files (and strings) are read in full
+	if (m_Fd < 0)
+	{
+		return true;
+	}
+
+#ifdef _WIN32
+	return true;
+#else
+	// Readable, at the end or broken (which 'fill' then finds)
+	pollfd pfd = { m_Fd, POLLIN, 0 };
+	return poll(&pfd, 1, 0) != 0;
+#endif
+}
+
+bool InputSource::require(size_t size)
+{
+	while (m_End - m_Pos < size)
+	{
+		size_t keep = m_Pos;
+		if (!fill(keep))
+		{
+			return false;
+		}
+		m_Pos = keep;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <utility>
+#include <cstdio>
+
+#include "MappedFile.hpp"
+#include "Frame.hpp"
+
+// Reader for the 'in' location, which splits the input into words separated
+// by whitespace. Input is read in large blocks (or mapped, when it's a file)
+// and words are views into it, so nothing is allocated per word.
+class InputSource
+{
+public:
+	explicit InputSource(std::FILE *file = stdin);
+	explicit InputSource(MappedFile &&file);
+	// The string isn't copied, so must outlive the source (for embedding)
+	explicit InputSource(std::string_view str);
+
+	InputSource(const InputSource &source) = delete;
+	InputSource &operator=(const InputSource &source) = delete;
+
+	// Nothing at the end of the input, the word is only valid until the next
+	std::optional<std::string_view> nextWord();
+
+	// Whether the next word (or frame) can be read without blocking, which is
+	// also the case at the end of the input. Always true on Windows, where
+	// pipes can't be polled.
+	bool isWordReady();
+	bool isFrameReady();
+
+	// Next frame of the binary wire format (see 'Frame.hpp'), nothing at the end
+	// of the input. The payload is only valid until the next read.
+	std::optional<std::pair<FrameTag, std::string_view>> nextFrame();
+
+	// Source for stdin shared by machines which weren't given one
+	static InputSource &getStdin();
+
+private:
+	// Reads more input after 'm_End', moving what's from 'keep' onwards to the
+	// start of the buffer. False at the end of the input.
+	bool fill(size_t &keep);
+
+	// Reads until at least 'size' bytes after 'm_Pos' are available
+	bool require(size_t size);
+
+	// Whether more input can be read without blocking
+	bool canFill() const;
+
+private:
+	int m_Fd = -1;
+	std::optional<MappedFile> m_File;
+
+	std::vector<char> m_Buffer;
+	const char *m_Data = nullptr;
+	size_t m_Pos = 0;
+	size_t m_End = 0;
+
+	static const size_t s_BlockSize = 64 * 1024;
+};
\ No newline at end of file
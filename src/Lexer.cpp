@@ -1,60 +1,90 @@
 #include "Lexer.hpp"
 
-#include <iostream>
-#include <sstream>
+#include <cinttypes>
+#include <algorithm>
 
-Lexer::Lexer(const std::string &source)
-	: m_Stream(nullptr)
+enum CharClass : uint8_t
 {
-	m_Stream = std::make_unique<std::istringstream>(source);
+	k_Space  = 1 << 0,
+	k_Alpha  = 1 << 1,
+	k_Digit  = 1 << 2,
+	k_Symbol = 1 << 3, // Single character token
+};
 
-	m_CurrCharIdx = 0;
-	m_CurrTokenIdx = 0;
+struct CharTable
+{
+	std::array<uint8_t, 256> Classes = {};
+	std::array<Token, 256> Symbols = {};
+};
+
+static constexpr CharTable makeCharTable()
+{
+	CharTable table;
 
-	for (auto i = 0; i < s_Lookahead; ++i)
+	for (unsigned char c : std::string_view(" \t\n\v\f\r"))
 	{
-		if ((!m_Tokens.empty() && m_Tokens.back() != Token::Eof) ||
-			m_Tokens.empty())
-		{
-			if (auto tokenOpt = advance())
-			{
-				auto [token, buffer] = tokenOpt.value();
-				
-				m_Tokens.push_back(token);
-				m_Buffers.push_back(buffer);
-			}
-		}
+		table.Classes[c] |= k_Space;
 	}
-}
 
-void Lexer::next()
-{
-	if ((!m_Tokens.empty() && m_Tokens.back() != Token::Eof) ||
-		m_Tokens.empty())
+	for (int c = 0; c < 26; ++c)
 	{
-		if (auto tokenOpt = advance())
-		{
-			auto [token, buffer] = tokenOpt.value();
+		table.Classes['a' + c] |= k_Alpha;
+		table.Classes['A' + c] |= k_Alpha;
+	}
 
-			m_Tokens.push_back(token);
-			m_Buffers.push_back(buffer);
-		}
+	for (int c = 0; c < 10; ++c)
+	{
+		table.Classes['0' + c] |= k_Digit;
 	}
-	
-	if (m_CurrTokenIdx < m_Tokens.size())
+
+	constexpr std::pair<char, Token> k_Symbols[] = {
+		{'(', Token::Lb}, {')', Token::Rb},
+		{'<', Token::Lab}, {'>', Token::Rab},
+		{'[', Token::Lsb}, {']', Token::Rsb},
+		{'*', Token::Asterisk}, {'.', Token::Dot}, {'=', Token::Equal},
+		{',', Token::Comma}, {'_', Token::Underscore}, {'@', Token::Ampersand},
+		{'#', Token::Hash}, {'+', Token::Plus}
+	};
+
+	for (auto [c, token] : k_Symbols)
 	{
-		m_CurrTokenIdx++;
+		table.Classes[static_cast<unsigned char>(c)] |= k_Symbol;
+		table.Symbols[static_cast<unsigned char>(c)] = token;
 	}
+
+	return table;
+}
+
+static constexpr CharTable k_CharTable = makeCharTable();
+
+static bool isCharClass(char c, uint8_t charClass)
+{
+	return k_CharTable.Classes[static_cast<unsigned char>(c)] & charClass;
 }
 
-std::optional<std::pair<Token, std::string>> Lexer::getPeek(size_t n) const
+Lexer::Lexer(std::string_view source, size_t begin)
+	: m_Source(source)
+	, m_CurrCharIdx(std::min(begin, source.size()))
+	, m_CurrTokenIdx(0)
 {
-	if (n < s_Lookahead)
+	for (size_t i = 0; i < s_Lookahead; ++i)
 	{
-		auto token = m_Tokens[m_CurrTokenIdx + n];
-		auto buffer = m_Buffers[m_CurrTokenIdx + n];
+		m_Tokens[i] = advance();
+	}
+}
 
-		return std::make_pair(token, buffer);
+void Lexer::next()
+{
+	// The current token is replaced by the next one after the lookahead
+	m_Tokens[m_CurrTokenIdx] = advance();
+	m_CurrTokenIdx = (m_CurrTokenIdx + 1) % s_Lookahead;
+}
+
+std::optional<std::pair<Token, std::string_view>> Lexer::getPeek(size_t n) const
+{
+	if (n < s_Lookahead)
+	{
+		return m_Tokens[(m_CurrTokenIdx + n) % s_Lookahead];
 	}
 
 	return std::nullopt;
@@ -64,21 +94,17 @@ std::optional<Token> Lexer::getPeekToken(size_t n) const
 {
 	if (n < s_Lookahead)
 	{
-		auto token = m_Tokens[m_CurrTokenIdx + n];
-
-		return token;
+		return m_Tokens[(m_CurrTokenIdx + n) % s_Lookahead].first;
 	}
 
 	return std::nullopt;
 }
 
-std::optional<std::string> Lexer::getPeekBuffer(size_t n) const
+std::optional<std::string_view> Lexer::getPeekBuffer(size_t n) const
 {
 	if (n < s_Lookahead)
 	{
-		auto buffer = m_Buffers[m_CurrTokenIdx + n];
-
-		return buffer;
+		return m_Tokens[(m_CurrTokenIdx + n) % s_Lookahead].second;
 	}
 
 	return std::nullopt;
@@ -88,164 +114,95 @@ bool Lexer::isPeekToken(Token token, size_t n) const
 {
 	if (n < s_Lookahead)
 	{
-		return token == m_Tokens[m_CurrTokenIdx + n];;
+		return token == m_Tokens[(m_CurrTokenIdx + n) % s_Lookahead].first;
 	}
 
 	return false;
 }
 
-const std::string &Lexer::getBuffer() const
+std::optional<size_t> Lexer::getPeekPos(size_t n) const
 {
-	return m_Buffer;
+	if (n < s_Lookahead)
+	{
+		return m_Tokens[(m_CurrTokenIdx + n) % s_Lookahead].second.data() - m_Source.data();
+	}
+
+	return std::nullopt;
 }
 
-std::optional<std::pair<Token, std::string>> Lexer::advance()
+std::string_view Lexer::getBuffer() const
 {
-	std::string buffer;
+	return m_Source.substr(0, m_CurrCharIdx);
+}
 
-	char c = m_Stream->get();
-	
-	if (c == std::istream::traits_type::eof())
-	{
-		return std::make_pair(Token::Eof, buffer);
-	}
+std::pair<Token, std::string_view> Lexer::advance()
+{
+	const size_t size = m_Source.size();
+	const char *src = m_Source.data();
 
-	m_CurrCharIdx++;
-	m_Buffer += c;
-	
 	// Eat whitespace (includes nl & cr)
-	while (std::isspace(c))
+	while (m_CurrCharIdx < size && isCharClass(src[m_CurrCharIdx], k_Space))
 	{
-		c = m_Stream->get();
-		
-		if (c == std::istream::traits_type::eof())
-		{
-			return std::make_pair(Token::Eof, buffer);
-		}
-
 		m_CurrCharIdx++;
-		m_Buffer += c;
 	}
 
-	buffer += c;
-
-	if (c == '(')
+	if (m_CurrCharIdx >= size)
 	{
-		return std::make_pair(Token::Lb, buffer);
+		return std::make_pair(Token::Eof, std::string_view(src + size, 0));
 	}
-	else if (c == ')')
-	{
-		return std::make_pair(Token::Rb, buffer);
-	}
-	else if (c == '<')
-	{
-		return std::make_pair(Token::Lab, buffer);
-	}
-	else if (c == '>')
-	{
-		return std::make_pair(Token::Rab, buffer);
-	}
-	if (c == '[')
-	{
-		return std::make_pair(Token::Lsb, buffer);
-	}
-	else if (c == ']')
-	{
-		return std::make_pair(Token::Rsb, buffer);
-	}
-	else if (c == '*')
-	{
-		return std::make_pair(Token::Asterisk, buffer);
-	}
-	else if (c == '.')
-	{
-		return std::make_pair(Token::Dot, buffer);
-	}
-	else if (c == '=')
-	{
-		return std::make_pair(Token::Equal, buffer);
-	}
-	else if (c == ',')
-	{
-		return std::make_pair(Token::Comma, buffer);
-	}
-	else if (c == '_')
-	{
-		return std::make_pair(Token::Underscore, buffer);
-	}
-	else if (c == '@')
-	{
-		return std::make_pair(Token::Ampersand, buffer);
-	}
-	else if (c == '#')
-	{
-		return std::make_pair(Token::Hash, buffer);
-	}
-	else if (c == '+')
+
+	size_t start = m_CurrCharIdx;
+	char c = src[m_CurrCharIdx++];
+
+	auto getView = [&]() {
+		return std::string_view(src + start, m_CurrCharIdx - start);
+	};
+
+	if (isCharClass(c, k_Symbol))
 	{
-		return std::make_pair(Token::Plus, buffer);
+		return std::make_pair(k_CharTable.Symbols[static_cast<unsigned char>(c)], getView());
 	}
 	else if (c == '-')
 	{
-		c = m_Stream->get();
-		m_CurrCharIdx++;
-		m_Buffer += c;
-
-		if (c == '>')
+		if (m_CurrCharIdx < size && src[m_CurrCharIdx] == '>')
 		{
-			buffer += c;
-
-			return std::make_pair(Token::Arrow, buffer);
+			m_CurrCharIdx++;
+			return std::make_pair(Token::Arrow, getView());
 		}
 
-		m_Stream->putback(c);
-		m_CurrCharIdx--;
-		m_Buffer.pop_back();
-
-		return std::make_pair(Token::Minus, buffer);
+		return std::make_pair(Token::Minus, getView());
 	}
-	else if (std::isalpha(c))
+	else if (isCharClass(c, k_Alpha))
 	{
-		c = m_Stream->get();
-		m_CurrCharIdx++;
-		m_Buffer += c;
-
-		while (std::isalnum(c) || c == '_')
+		while (m_CurrCharIdx < size)
 		{
-			buffer += c;
-
-			c = m_Stream->get();
-			m_CurrCharIdx++;
-			m_Buffer += c;
+			if (isCharClass(src[m_CurrCharIdx], k_Alpha | k_Digit) || src[m_CurrCharIdx] == '_')
+			{
+				m_CurrCharIdx++;
+			}
+			// Identifiers qualified by a module, i.e. 'module::name'
+			else if (m_CurrCharIdx + 2 < size && src[m_CurrCharIdx] == ':' && src[m_CurrCharIdx + 1] == ':'
+				&& isCharClass(src[m_CurrCharIdx + 2], k_Alpha))
+			{
+				m_CurrCharIdx += 3;
+			}
+			else
+			{
+				break;
+			}
 		}
 
-		m_Stream->putback(c);
-		m_CurrCharIdx--;
-		m_Buffer.pop_back();
-
-		return std::make_pair(Token::Id, buffer);
+		return std::make_pair(Token::Id, getView());
 	}
-	else if (std::isdigit(c))
+	else if (isCharClass(c, k_Digit))
 	{
-		c = m_Stream->get();
-		m_CurrCharIdx++;
-		m_Buffer += c;
-
-		while (std::isdigit(c))
+		while (m_CurrCharIdx < size && isCharClass(src[m_CurrCharIdx], k_Digit))
 		{
-			buffer += c;
-
-			c = m_Stream->get();
 			m_CurrCharIdx++;
-			m_Buffer += c;
 		}
-		
-		m_Stream->putback(c);
-		m_CurrCharIdx--;
-		m_Buffer.pop_back();
 
-		return std::make_pair(Token::Primitive, buffer);
+		return std::make_pair(Token::Primitive, getView());
 	}
 
-	return std::nullopt;
+	return std::make_pair(Token::Unknown, getView());
 }
\ No newline at end of file
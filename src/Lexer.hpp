@@ -1,12 +1,10 @@
 #pragma once
 
-#include <iostream>
-#include <istream>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <utility>
-#include <memory>
-#include <vector>
+#include <array>
 
 enum class Token
 {
@@ -28,13 +26,19 @@ enum class Token
 	Primitive, // Primitive, i.e. integer, bool, etc.
 	Id, // Identifier, i.e. location name, variable name, function name etc.
 
+	Unknown, // Any other character
+
 	Eof // End of line
 };
 
+// Lexes the source in place, so tokens are views into it (and the source must
+// outlive the lexer).
 class Lexer
 {
 public:
-	explicit Lexer(const std::string &source);
+	// Lexing starts from 'begin', though the whole source is still visible
+	// (so buffers & positions are always relative to the start of it)
+	explicit Lexer(std::string_view source, size_t begin = 0);
 
 	Lexer(const Lexer &) = delete;
 	Lexer &operator=(const Lexer &) = delete;
@@ -42,26 +46,28 @@ public:
 	Lexer(Lexer &&) = delete;
 	Lexer &operator=(Lexer &&) = delete;
 
-	const std::string &getBuffer() const;
+	// Source which has been lexed so far (including the lookahead)
+	std::string_view getBuffer() const;
 
 	void next();
-	std::optional<std::pair<Token, std::string>> getPeek(size_t n = 0) const;
+	std::optional<std::pair<Token, std::string_view>> getPeek(size_t n = 0) const;
 	std::optional<Token> getPeekToken(size_t n = 0) const;
-	std::optional<std::string> getPeekBuffer(size_t n = 0) const;
+	std::optional<std::string_view> getPeekBuffer(size_t n = 0) const;
 	bool isPeekToken(Token token, size_t n = 0) const;
 
+	// Position of the token within the source
+	std::optional<size_t> getPeekPos(size_t n = 0) const;
+
 private:
-	std::optional<std::pair<Token, std::string>> advance();
+	std::pair<Token, std::string_view> advance();
 
 private:
 	static const size_t s_Lookahead = 3;
 
+	std::string_view m_Source;
 	size_t m_CurrCharIdx;
-	std::string m_Buffer;
 
+	// Ring buffer of the lookahead, the current token being at 'm_CurrTokenIdx'
 	size_t m_CurrTokenIdx;
-	std::vector<Token> m_Tokens;
-	std::vector<std::string> m_Buffers;
-
-	std::unique_ptr<std::istream> m_Stream;
-};
+	std::array<std::pair<Token, std::string_view>, s_Lookahead> m_Tokens;
+};
\ No newline at end of file
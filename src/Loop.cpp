@@ -0,0 +1,244 @@
+#include "Loop.hpp"
+
+#include <algorithm>
+
+// Loops are compiled from the original sequences of superinstructions
+static TermHandle_t unfuse(TermHandle_t term)
+{
+	if (term->isBinOpVars() || term->isPeekPair() || term->isMove())
+	{
+		return term->getOriginal();
+	}
+
+	return term;
+}
+
+std::optional<Loop> Loop::compile(Var_t funcName, TermHandle_t term)
+{
+	Loop loop;
+	loop.m_FuncName = funcName;
+
+	TermHandle_t body = term;
+
+	if (loop.compileParams(body) && !loop.m_Params.empty() &&
+		loop.compileSeq(body, 0) && loop.m_IsRecursive)
+	{
+		return loop;
+	}
+
+	return std::nullopt;
+}
+
+size_t Loop::getArity() const
+{
+	return m_Params.size();
+}
+
+std::optional<std::vector<Prim_t>> Loop::run(std::vector<Prim_t> &args, uint64_t &numIters) const
+{
+	uint64_t maxIters = numIters;
+	numIters = 0;
+
+	if (maxIters == 0)
+	{
+		return std::nullopt;
+	}
+	numIters++;
+
+	std::vector<Prim_t> &slots = args;
+	std::vector<Prim_t> stack;
+	stack.reserve(m_MaxDepth);
+
+	size_t ip = 0;
+
+	while (true)
+	{
+		const Op &op = m_Ops[ip++];
+
+		switch (op.Type)
+		{
+		case Op::PushSlot:
+			stack.push_back(slots[op.Operand]);
+			break;
+		case Op::PushConst:
+			stack.push_back(op.Operand);
+			break;
+		case Op::Plus:
+		{
+			Prim_t prim = stack.back();
+			stack.pop_back();
+			stack.back() = stack.back() + prim;
+			break;
+		}
+		case Op::Minus:
+		{
+			Prim_t prim = stack.back();
+			stack.pop_back();
+			stack.back() = stack.back() - prim;
+			break;
+		}
+		case Op::Cases:
+		{
+			Prim_t prim = stack.back();
+			stack.pop_back();
+
+			const Cases &cases = m_Cases[op.Operand];
+			auto itArm = cases.Arms.find(prim);
+			ip = (itArm != cases.Arms.end()) ? itArm->second : cases.Otherwise;
+			break;
+		}
+		case Op::Exit:
+			return stack;
+		case Op::Recur:
+			// The first parameter binds the top of the stack
+			for (size_t i = 0; i < slots.size(); ++i)
+			{
+				slots[i] = stack.back();
+				stack.pop_back();
+			}
+
+			if (numIters == maxIters)
+			{
+				return std::nullopt;
+			}
+			numIters++;
+
+			ip = 0;
+			break;
+		}
+	}
+}
+
+bool Loop::compileParams(TermHandle_t &term)
+{
+	while (true)
+	{
+		TermHandle_t head = unfuse(term);
+
+		if (!head->isAbs() || head->asAbs().getLoc() != k_LambdaLoc)
+		{
+			return true;
+		}
+
+		m_Params.push_back(head->asAbs().getVar());
+		term = head->getBody();
+	}
+}
+
+bool Loop::compileSeq(TermHandle_t term, size_t depth)
+{
+	auto findSlot = [&](const Var_t &var) -> std::optional<int32_t> {
+		for (size_t i = m_Params.size(); i > 0; --i)
+		{
+			if (m_Params[i - 1] == var)
+			{
+				return static_cast<int32_t>(i - 1);
+			}
+		}
+		return std::nullopt;
+	};
+
+	while (true)
+	{
+		term = unfuse(term);
+
+		if (term->isNil())
+		{
+			m_Ops.push_back({Op::Exit, static_cast<int32_t>(depth)});
+			return true;
+		}
+		else if (term->isApp())
+		{
+			const AppTerm &app = term->asApp();
+			TermHandle_t arg = term->getArg();
+
+			if (app.getLoc() != k_LambdaLoc)
+			{
+				return false;
+			}
+
+			if (arg->isVar() && arg->getBody()->isNil())
+			{
+				if (auto slotOpt = findSlot(arg->asVar().getVar()))
+				{
+					m_Ops.push_back({Op::PushSlot, slotOpt.value()});
+				}
+				else
+				{
+					return false;
+				}
+			}
+			else if (arg->isVal() && arg->asVal().isPrim())
+			{
+				m_Ops.push_back({Op::PushConst, arg->asVal().asPrim()});
+			}
+			else
+			{
+				return false;
+			}
+
+			depth++;
+			m_MaxDepth = std::max(m_MaxDepth, depth);
+			term = term->getBody();
+		}
+		else if (term->isBinOp())
+		{
+			const BinOpTerm &binOp = term->asBinOp();
+
+			if (depth < 2)
+			{
+				return false;
+			}
+
+			m_Ops.push_back({binOp.isOp(BinOpTerm::Plus) ? Op::Plus : Op::Minus, 0});
+			depth--;
+			term = term->getBody();
+		}
+		else if (term->isVar())
+		{
+			const VarTerm &var = term->asVar();
+
+			// Only a tail call with exactly the parameters on the stack can loop
+			// (a parameter named after the function isn't the function)
+			if (var.getVar() != m_FuncName || findSlot(var.getVar()) || !term->getBody()->isNil() || depth != m_Params.size())
+			{
+				return false;
+			}
+
+			m_Ops.push_back({Op::Recur, static_cast<int32_t>(depth)});
+			m_IsRecursive = true;
+			return true;
+		}
+		else if (term->isPrimCases())
+		{
+			const CasesTerm<Prim_t> &cases = term->asPrimCases();
+
+			if (depth < 1 || !term->getBody()->isNil())
+			{
+				return false;
+			}
+
+			size_t casesIdx = m_Cases.size();
+			m_Cases.emplace_back();
+			m_Ops.push_back({Op::Cases, static_cast<int32_t>(casesIdx)});
+
+			for (uint32_t i = 0; i < cases.getNumCases(); ++i)
+			{
+				TermHandle_t arm = term->getCase(i);
+
+				m_Cases[casesIdx].Arms[arm->asVal().asPrim()] = m_Ops.size();
+				if (!compileSeq(arm->getArg(), depth - 1))
+				{
+					return false;
+				}
+			}
+
+			m_Cases[casesIdx].Otherwise = m_Ops.size();
+			return compileSeq(term->getOtherwise(), depth - 1);
+		}
+		else
+		{
+			return false;
+		}
+	}
+}
\ No newline at end of file
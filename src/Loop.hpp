@@ -0,0 +1,76 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+#include <map>
+#include <cinttypes>
+
+#include "Term.hpp"
+
+// A self-recursive definition which only shuffles primitives on the 'lambda'
+// stack, compiled into a flat sequence of operations over local slots, e.g.
+//
+//   multiply_aux = (
+//       <t> . <n> . <m> . [m] . (
+//           0 -> [t],
+//           otherwise -> [m] . [1] . - . [n] . [t] . [n] . + . multiply_aux
+//       )
+//   )
+//
+// Its parameters are popped from 'lambda' into slots, each tail call rebinds
+// the slots and jumps back to the start, and whatever is left on the operand
+// stack when an arm finishes is pushed back onto 'lambda'.
+class Loop
+{
+public:
+	Loop(const Loop &loop) = delete;
+	Loop(Loop &&loop) = default;
+
+	Loop &operator=(const Loop &loop) = delete;
+	Loop &operator=(Loop &&loop) = delete;
+
+	static std::optional<Loop> compile(Var_t funcName, TermHandle_t term);
+
+	size_t getArity() const;
+
+	// Takes the arguments (top of 'lambda' first) and returns the results
+	// (bottom of the operand stack first), running at most 'numIters'
+	// iterations (the call itself & each tail call being one). When it runs
+	// out first nothing is returned, and 'args' are those of the next call.
+	// Either way 'numIters' is set to the iterations run.
+	std::optional<std::vector<Prim_t>> run(std::vector<Prim_t> &args, uint64_t &numIters) const;
+
+private:
+	struct Op
+	{
+		enum Kind
+		{
+			PushSlot, PushConst, Plus, Minus, Cases, Exit, Recur
+		};
+
+		Kind Type;
+		int32_t Operand;
+	};
+
+	struct Cases
+	{
+		std::map<Prim_t, size_t> Arms;
+		size_t Otherwise;
+	};
+
+	Loop() = default;
+
+	bool compileParams(TermHandle_t &term);
+	bool compileSeq(TermHandle_t term, size_t depth);
+
+private:
+	Var_t m_FuncName = k_NoSymbol;
+	std::vector<std::optional<Var_t>> m_Params;
+
+	std::vector<Op> m_Ops;
+	std::vector<Cases> m_Cases;
+
+	size_t m_MaxDepth = 0;
+	bool m_IsRecursive = false;
+};
\ No newline at end of file
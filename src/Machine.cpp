@@ -1,91 +1,313 @@
 #include "Machine.hpp"
 
+#include <iostream>
 #include <sstream>
+#include <algorithm>
 
 #include "Utils.hpp"
+#include "Device.hpp"
+#include "Printer.hpp"
 
-static void machineError(std::string message, const Machine &machine)
+// Thrown to stop the machine, the report being what's displayed (or returned)
+struct MachineError
 {
-	std::string stackDebug = machine.getStackDebug();
-	std::string callstackDebug = machine.getCallstackDebug();
+	std::string Report;
+};
 
-	std::cerr << "[Machine Error] ";
-	std::cerr << message << std::endl;
+static std::string makeReport(std::string message, const Machine &machine)
+{
+	std::stringstream report;
+	report << "[Machine Error] " << message << '\n';
 
+	for (const std::string &debug : { machine.getCallstackDebug(), machine.getStackDebug() })
 	{
-		std::stringstream ss(callstackDebug);
+		std::stringstream ss(debug);
 		std::string line;
 
 		while (std::getline(ss, line))
 		{
-			std::cerr << "| " << line << std::endl;
+			report << "| " << line << '\n';
 		}
 	}
 
+	return report.str();
+}
+
+static void machineError(std::string message, const Machine &machine)
+{
+	throw MachineError{makeReport(std::move(message), machine)};
+}
+
+// The message followed by a report (e.g. of a child machine), indented
+static std::string nestReport(std::string message, const std::string &report)
+{
+	std::stringstream ss(report);
+	std::string line;
+
+	while (std::getline(ss, line))
 	{
-		std::stringstream ss(stackDebug);
-		std::string line;
+		message += "\n  " + line;
+	}
 
-		while (std::getline(ss, line))
+	return message;
+}
+
+static std::string getCallName(const CallFrame &frame)
+{
+	switch (frame.Type)
+	{
+	case CallFrame::Main:
+		return "main";
+	case CallFrame::Spawned:
+		return "Spawned";
+	case CallFrame::Func:
+		return getSymbolName(frame.Symbol);
+	case CallFrame::Binding:
+		return "Binding of '" + getSymbolName(frame.Symbol) + "'";
+	case CallFrame::PrimCase:
+		return "Case '" + std::to_string(frame.Prim) + "'";
+	case CallFrame::LocCase:
+		return "Case '" + getLocName(frame.Symbol) + "'";
+	case CallFrame::Otherwise:
+		return "Case 'otherwise'";
+	}
+	return {};
+}
+
+static const Closure_t *findBinding(const Env_t &env, const Var_t &var)
+{
+	auto itEnv = env.first.find(var);
+	if (itEnv != env.first.end())
+	{
+		return reinterpret_cast<Closure_t *>(itEnv->second.get());
+	}
+	return nullptr;
+}
+
+static std::optional<Prim_t> findPrimBinding(const Env_t &env, const Var_t &var)
+{
+	if (const Closure_t *closure = findBinding(env, var))
+	{
+		if (closure->second->isVal() && closure->second->asVal().isPrim())
 		{
-			std::cerr << "| " << line << std::endl;
+			return closure->second->asVal().asPrim();
 		}
 	}
+	return std::nullopt;
+}
+
+Machine::Machine()
+{
+	addDevice("new", std::make_unique<NewDevice>());
+	addDevice("in", std::make_unique<InputDevice>());
+	addDevice("out", std::make_unique<OutputDevice>());
+	addDevice("null", std::make_unique<NullDevice>());
+	addDevice("spawn", std::make_unique<SpawnDevice>());
+	addDevice("chan", std::make_unique<ChanDevice>());
+}
 
-	std::exit(1);
+Machine::~Machine()
+{
+	stopSpawns();
 }
 
-static std::string locGenerator()
+bool Machine::addDevice(std::string_view name, std::unique_ptr<Device> &&device)
 {
-	constexpr const char *k_Src = "xyzwv";
-	static int ptrs[] = {0, 0, 0, 0, 0};
+	Loc_t loc = internSymbol(name);
 
-	std::string str;
-	str += k_Src[ptrs[0] % 5];
-	str += k_Src[ptrs[1] % 5];
-	str += k_Src[ptrs[2] % 5];
-	str += k_Src[ptrs[3] % 5];
-	str += k_Src[ptrs[4] % 5];
+	// Binary operations & loops use 'lambda' as a stack
+	if (loc == k_LambdaLoc)
+	{
+		return false;
+	}
 
-	if (ptrs[0] < 5 * 5 * 5 * 5 * 5 - 1)
+	if (loc >= m_Devices.size())
 	{
-		ptrs[0] = (ptrs[0] + 1); 
-		ptrs[1] = (ptrs[1] + (ptrs[0] % 5 == 0));
-		ptrs[2] = (ptrs[2] + (ptrs[0] % 25 == 0));
-		ptrs[3] = (ptrs[3] + (ptrs[0] % 125 == 0));
-		ptrs[4] = (ptrs[4] + (ptrs[0] % 725 == 0));
+		m_Devices.resize(loc + 1);
 	}
 
-	return "loc_" + str;
+	m_Devices[loc] = std::move(device);
+	return true;
 }
 
 void Machine::execute(const Program &program)
 {
+	if (auto errorOpt = tryExecute(program))
+	{
+		std::cerr << errorOpt.value() << std::flush;
+		std::exit(1);
+	}
+}
+
+std::optional<std::string> Machine::tryExecute(const Program &program)
+{
+	start(program);
+
+	// Nothing else is run on this thread, so it may as well block
+	if (resume(0) == MachineStatus::Error)
+	{
+		return m_Error;
+	}
+	return std::nullopt;
+}
+
+void Machine::start(const Program &program)
+{
+	stopSpawns();
+
 	m_Memory.clear();
 	m_Control.clear();
+	m_CallStack.clear();
+	m_NumFreshLocs = 0;
+	m_NumSteps = 0;
+	m_Program = &program;
+	m_Error.reset();
+
+	std::optional<TermHandle_t> termOpt;
+	try
+	{
+		termOpt = loadFunc(program, internSymbol("main"));
+	}
+	catch (const MachineError &error)
+	{
+		m_Error = error.Report;
+		m_Status = MachineStatus::Error;
+		return;
+	}
 
-	if (auto termOpt = program.load("main"))
+	if (termOpt)
 	{
 		m_Control.push_back(
 			std::make_pair(Env_t{}, termOpt.value())
 		);
 
-		m_CallStack.push_back({"main", termOpt.value()});
+		m_CallStack.push_back({CallFrame::Main, k_NoSymbol, 0, termOpt.value()});
+		m_Status = MachineStatus::Paused;
 	}
 	else
 	{
-		machineError("Program has no entry point ('main' is not defined)!", *this);
-		return;
+		m_Error = makeReport("Program has no entry point ('main' is not defined)!", *this);
+		m_Status = MachineStatus::Error;
+	}
+}
+
+MachineStatus Machine::run(uint64_t maxSteps)
+{
+	return runSlice(maxSteps, false);
+}
+
+MachineStatus Machine::resume(uint64_t maxSteps)
+{
+	return runSlice(maxSteps, true);
+}
+
+MachineStatus Machine::getStatus() const
+{
+	return m_Status;
+}
+
+const std::optional<std::string> &Machine::getError() const
+{
+	return m_Error;
+}
+
+MachineStatus Machine::runSlice(uint64_t maxSteps, bool canBlock)
+{
+	if (m_Status != MachineStatus::Paused && m_Status != MachineStatus::Waiting)
+	{
+		return m_Status;
+	}
+
+	m_CanBlock = canBlock;
+
+	try
+	{
+		m_Status = runControl(maxSteps);
+	}
+	catch (const MachineError &error)
+	{
+		m_Error = error.Report;
+		m_Status = MachineStatus::Error;
+	}
+
+	// Output is left to its flush policy between slices
+	if (m_Status == MachineStatus::Paused)
+	{
+		return m_Status;
 	}
 
+	// Children which were never joined have nothing left to give
+	if (m_Status != MachineStatus::Waiting)
+	{
+		stopSpawns();
+	}
+
+	// Whatever was output comes before an error (and prompts before waiting),
+	// which spawned machines leave to their parent as they share its sink
+	if (!m_IsSpawned)
+	{
+		m_Output->flush();
+	}
+	return m_Status;
+}
+
+WorkStealingPool::Step Machine::runSpawned(const WorkStealingPool::Wake_t &wake)
+{
+	// Stopped (which wakes it if it was waiting), as the results aren't wanted
+	if (m_IsCancelled)
+	{
+		return WorkStealingPool::Step::Done;
+	}
+
+	switch (run(s_SpawnSlice))
+	{
+	case MachineStatus::Paused:
+		return WorkStealingPool::Step::Yield;
+	case MachineStatus::Waiting:
+		// Queued again once the channel it waits on is pushed to (or popped)
+		notifyWhenReady(WorkStealingPool::Wake_t(wake));
+		return WorkStealingPool::Step::Wait;
+	default:
+		return WorkStealingPool::Step::Done;
+	}
+}
+
+MachineStatus Machine::runControl(uint64_t maxSteps)
+{
+	const Program &program = *m_Program;
+
+	// Whichever comes first, the end of the slice or the step limit
+	m_EndStep = (maxSteps && maxSteps < m_MaxSteps - m_NumSteps) ? m_NumSteps + maxSteps : m_MaxSteps;
+
 	while (!m_Control.empty())
 	{
-		// Get the next environment and term
-		Closure_t closure = m_Control.back();
-		Env_t env = Env_t(closure.first);
-		TermHandle_t term = closure.second;
+		if (m_NumSteps == m_EndStep)
+		{
+			if (m_EndStep == m_MaxSteps)
+			{
+				machineError("Step limit of " + std::to_string(m_MaxSteps) + " reached !", *this);
+			}
+			return MachineStatus::Paused;
+		}
+		++m_NumSteps;
+
+		if (m_NumSteps % s_PollInterval == 0)
+		{
+			poll();
+		}
+
+		// Get the next environment and term (taking them, rather than copying)
+		Closure_t closure = std::move(m_Control.back());
 		m_Control.pop_back();
 
+		Env_t env = std::move(closure.first);
+		TermHandle_t term = closure.second;
+
+		if (m_IsProfiling)
+		{
+			profileTerm(term);
+		}
+
 		if (term->isNil())
 		{
 			if (!m_CallStack.empty())
@@ -97,30 +319,45 @@ void Machine::execute(const Program &program)
 		{
 			const VarTerm &var = term->asVar();
 
+			// The binding is owned by the environment, which moves with the continuation
+			const Closure_t *binding = findBinding(env, var.getVar());
+
 			// Push continuation term
-			m_Control.push_back(std::make_pair(env, var.getBody()));
+			m_Control.push_back(std::make_pair(std::move(env), term->getBody()));
+
+			const HostFunc *hostFunc = binding ? nullptr : program.loadHostFunc(var.getVar());
 
 			// We found term in our environment
-			auto itEnv = env.first.find(var.getVar());
-			if (itEnv != env.first.end())
+			if (binding)
 			{
 				// Push bound term
-				auto closurePtr = itEnv->second;
-				Closure_t *closure = reinterpret_cast<Closure_t *>(closurePtr.get());
-				m_Control.push_back(*closure);
-				m_CallStack.push_back({"Binding of '" + var.getVar() + "'", closure->second});
+				m_Control.push_back(*binding);
+				m_CallStack.push_back({CallFrame::Binding, var.getVar(), 0, binding->second});
 			}
+			// We found a native function (which takes precedence over program functions)
+			else if (hostFunc && tryRunHostFunc(*hostFunc))
+			{}
 			// We found term in our program functions
-			else if (auto termOpt = program.load(var.getVar()))
+			else if (auto termOpt = loadFunc(program, var.getVar()))
+			{
+				const Loop *loop = m_IsLoopsEnabled ? program.loadLoop(var.getVar()) : nullptr;
+
+				// Otherwise push program function
+				if (!loop || !tryRunLoop(*loop))
+				{
+					m_Control.push_back(std::make_pair(Env_t{}, termOpt.value()));
+					m_CallStack.push_back({CallFrame::Func, var.getVar(), 0, termOpt.value()});
+				}
+			}
+			else if (hostFunc)
 			{
-				// Push program function
-				m_Control.push_back(std::make_pair(Env_t{}, termOpt.value()));
-				m_CallStack.push_back({var.getVar(), termOpt.value()});
+				machineError("Host function '" + getSymbolName(var.getVar()) + "' "
+					+ "can only be called with primitive arguments !", *this);
 			}
 			// We didn't find our term anywhere.. error !
 			else
 			{
-				machineError("Variable '" + var.getVar() + "' "
+				machineError("Variable '" + getSymbolName(var.getVar()) + "' "
 					+ "is not bound to anything !", *this);
 			}
 		}
@@ -128,27 +365,17 @@ void Machine::execute(const Program &program)
 		{
 			const AppTerm &app = term->asApp();
 
-			m_Control.push_back(std::make_pair(env, app.getBody()));
+			m_Control.push_back(std::make_pair(env, term->getBody()));
 
 			auto appActionWithLoc = [&](Loc_t loc) {
-				// New stream
-				if (loc == k_NewLoc)
-				{
-					machineError("Application cannot push to 'new' location !", *this);
-				}
-				// Input stream
-				else if (loc == k_InputLoc)
-				{
-					machineError("Application cannot push to 'input' location !", *this);
-				}
-				// Output stream
-				else if (loc == k_OutputLoc)
+				// Device
+				if (Device *device = getDevice(loc))
 				{
-					std::cout << stringifyClosure(std::make_pair(env, app.getArg())) << std::endl;
+					if (!device->push(*this, env, term->getArg()))
+					{
+						machineError("Application cannot push to '" + getLocName(loc) + "' location !", *this);
+					}
 				}
-				// Null stream
-				else if (loc == k_NullLoc)
-				{}
 				// Generic stack
 				else
 				{
@@ -158,15 +385,14 @@ void Machine::execute(const Program &program)
 
 					bool hasPushedAsValue = false;
 					
-					if (app.getArg()->isVar())
+					if (term->getArg()->isVar())
 					{
-						const VarTerm &var = app.getArg()->asVar();
+						const VarTerm &var = term->getArg()->asVar();
 
 						auto itEnv = env.first.find(var.getVar());
 						if (itEnv != env.first.end())
 						{
-							auto closurePtr = itEnv->second;
-							Closure_t *closure = reinterpret_cast<Closure_t *>(closurePtr.get());
+							const Closure_t *closure = reinterpret_cast<const Closure_t *>(itEnv->second.get());
 
 							if (closure->second->isVal())
 							{
@@ -178,24 +404,25 @@ void Machine::execute(const Program &program)
 
 					if (!hasPushedAsValue)
 					{
-						m_Memory[loc].push_back(std::make_pair(env, app.getArg()));
+						m_Memory[loc].push_back(std::make_pair(env, term->getArg()));
 					}
 				}
 			};
 
-			auto itEnv = env.second.find(app.getLoc());
-			if (itEnv != env.second.end())
-			{
-				appActionWithLoc(itEnv->second);
-			}
-			else if (isReservedLoc(app.getLoc()))
+			if (auto locOpt = resolveLoc(env, app.getLoc()))
 			{
-				appActionWithLoc(app.getLoc());
+				if (!canPush(locOpt.value()))
+				{
+					m_Control.pop_back();
+					return park(std::move(env), term, locOpt.value(), true);
+				}
+
+				appActionWithLoc(locOpt.value());
 			}
 			else
 			{
 				machineError("Application cannot push to (invalid) location '"
-					+ app.getLoc() + "' !", *this);
+					+ getLocName(app.getLoc()) + "' !", *this);
 			}
 		}
 		else if (term->isAbs())
@@ -203,146 +430,84 @@ void Machine::execute(const Program &program)
 			const AbsTerm &abs = term->asAbs();
 
 			auto absActionWithLoc = [&](Loc_t loc) {
-				// New stream
-				if (loc == k_NewLoc)
-				{
-					Loc_t newLoc = locGenerator();
-					m_Memory[newLoc] = {};
+				Device *device = getDevice(loc);
 
+				// Device, or generic stack
+				if (auto closureOpt = device ? device->pop(*this) : tryPop(env, loc))
+				{
 					if (abs.getVar())
 					{
-						env.first[abs.getVar().value()] = std::make_shared<Closure_t>(std::make_pair(
-							Env_t{}, freshTerm(ValTerm(newLoc))
-						));
+						env.first[abs.getVar().value()] = std::make_shared<Closure_t>(std::move(closureOpt.value()));
 					}
 
-					m_Control.push_back(std::make_pair(env, abs.getBody()));
-				}
-				// Input stream
-				else if (loc == k_InputLoc)
-				{
-					std::string in;
-					std::cin >> in;
-
-					Parser parser;
-					if (auto termOpt = parser.parseTerm(in))
-					{
-						if (abs.getVar())
-						{
-							env.first[abs.getVar().value()] = std::make_shared<Closure_t>(std::make_pair(
-								Env_t{}, freshTerm(std::move(termOpt.value()))
-							));
-						}
-
-						m_Control.push_back(std::make_pair(env, abs.getBody()));
-					}
-					else
-					{
-						machineError("Cannot parse input '"
-							+ in + "' as term !", *this);
-					}
-				}
-				// Output stream
-				else if (loc == k_OutputLoc)
-				{
-					machineError("Abstraction cannot bind from 'output' location !", *this);
-				}
-				// Null stream
-				else if (loc == k_NullLoc)
-				{
-					machineError("Abstraction cannot bind from 'null' location !", *this);
+					m_Control.push_back(std::make_pair(std::move(env), term->getBody()));
 				}
-				// Generic stack
 				else
 				{
-					if (auto closureOpt = tryPop(env, loc))
-					{
-						if (abs.getVar())
-						{
-							env.first[abs.getVar().value()] = std::make_shared<Closure_t>(closureOpt.value());
-						}
-
-						m_Control.push_back(std::make_pair(env, abs.getBody()));
-					}
-					else
-					{
-						machineError("Abstraction cannot pop from location '"
-							+ loc + "' !", *this);
-					}
+					machineError("Abstraction cannot pop from location '"
+						+ getLocName(loc) + "' !", *this);
 				}
 			};
 
-			auto itEnv = env.second.find(abs.getLoc());
-			if (itEnv != env.second.end())
+			if (auto locOpt = resolveLoc(env, abs.getLoc()))
 			{
-				absActionWithLoc(itEnv->second);
-			}
-			else if (isReservedLoc(abs.getLoc()))
-			{
-				absActionWithLoc(abs.getLoc());
+				if (!canPop(locOpt.value()))
+				{
+					return park(std::move(env), term, locOpt.value(), false);
+				}
+
+				absActionWithLoc(locOpt.value());
 			}
 			else
 			{
 				machineError("Abstraction cannot pop from (invalid) location '"
-					+ abs.getLoc() + "' !", *this);
+					+ getLocName(abs.getLoc()) + "' !", *this);
 			}
 		}
 		else if (term->isLocApp())
 		{
 			const LocAppTerm &locApp = term->asLocApp();
 
-			m_Control.push_back(std::make_pair(env, locApp.getBody()));
+			m_Control.push_back(std::make_pair(env, term->getBody()));
 
 			auto appActionWithLoc = [&](Loc_t loc) {
-				// New stream
-				if (loc == k_NewLoc)
+				Loc_t locArg = locApp.getArg();
+
+				auto itEnv = env.second.find(locApp.getArg());
+				if (itEnv != env.second.end())
 				{
-					machineError("Location application cannot push to 'new' location ! ", *this);
+					locArg = itEnv->second;
 				}
-				// Input stream
-				else if (loc == k_InputLoc)
+
+				// Device
+				if (Device *device = getDevice(loc))
 				{
-					machineError("Location application cannot push to 'input' location ! ", *this);
+					if (!device->pushLoc(*this, locArg))
+					{
+						machineError("Location application cannot push to '" + getLocName(loc) + "' location !", *this);
+					}
 				}
-				// Null stream
-				else if (loc == k_NullLoc)
-				{}
+				// Generic stack
 				else
 				{
-					Loc_t locArg = locApp.getArg();
-
-					auto itEnv = env.second.find(locApp.getArg());
-					if (itEnv != env.second.end())
-					{
-						locArg = itEnv->second;
-					}
-
-					// Output stream
-					if (loc == k_OutputLoc)
-					{
-						std::cout << stringifyClosure(std::make_pair(env, freshTerm(ValTerm(locArg)))) << std::endl;
-					}
-					// Generic stack
-					else
-					{
-						m_Memory[loc].push_back(std::make_pair(env, freshTerm(ValTerm(locArg))));
-					}
+					m_Memory[loc].push_back(std::make_pair(env, freshTerm(ValTerm(locArg))));
 				}
 			};
 
-			auto itEnv = env.second.find(locApp.getLoc());
-			if (itEnv != env.second.end())
-			{
-				appActionWithLoc(itEnv->second);
-			}
-			else if (isReservedLoc(locApp.getLoc()))
+			if (auto locOpt = resolveLoc(env, locApp.getLoc()))
 			{
-				appActionWithLoc(locApp.getLoc());
+				if (!canPush(locOpt.value()))
+				{
+					m_Control.pop_back();
+					return park(std::move(env), term, locOpt.value(), true);
+				}
+
+				appActionWithLoc(locOpt.value());
 			}
 			else
 			{
 				machineError("Location application cannot push to (invalid) location '"
-					+ locApp.getLoc() + "' !", *this);
+					+ getLocName(locApp.getLoc()) + "' !", *this);
 			}
 		}
 		else if (term->isLocAbs())
@@ -350,79 +515,52 @@ void Machine::execute(const Program &program)
 			const LocAbsTerm &locAbs = term->asLocAbs();
 			
 			auto absActionWithLoc = [&](Loc_t loc) {
-				// New stream
-				if (loc == k_NewLoc)
-				{
-					Loc_t newLoc = locGenerator();
-					m_Memory[newLoc] = {};
+				Device *device = getDevice(loc);
 
+				// Device, or generic stack
+				if (auto locOpt = device ? device->popLoc(*this) : tryPopLoc(env, loc))
+				{
 					if (locAbs.getLocVar())
 					{
-						env.second[locAbs.getLocVar().value()] = newLoc;
+						env.second[locAbs.getLocVar().value()] = locOpt.value();
 					}
 
-					m_Control.push_back(std::make_pair(env, locAbs.getBody()));
-				}
-				// Input stream
-				else if (loc == k_InputLoc)
-				{
-					machineError("Location abstraction cannot pop from 'input' location !", *this);
+					m_Control.push_back(std::make_pair(std::move(env), term->getBody()));
 				}
-				// Output stream
-				else if (loc == k_OutputLoc)
-				{
-					machineError("Location abstraction cannot pop from 'output' location !", *this);
-				}
-				// Null stream
-				else if (loc == k_NullLoc)
-				{
-					machineError("Location abstraction cannot pop from 'null' location !", *this);
-				}
-				// Generic stack
 				else
 				{
-					if (auto locOpt = tryPopLoc(env, loc))
-					{
-						if (locAbs.getLocVar())
-						{
-							env.second[locAbs.getLocVar().value()] = locOpt.value();
-						}
-
-						m_Control.push_back(std::make_pair(env, locAbs.getBody()));
-					}
-					else
-					{
-						machineError("Location abstraction cannot pop from location '"
-							+ loc + "' !", *this);
-					}
+					machineError("Location abstraction cannot pop from location '"
+						+ getLocName(loc) + "' !", *this);
 				}
 			};
 
-			auto itEnv = env.second.find(locAbs.getLoc());
-			if (itEnv != env.second.end())
-			{
-				absActionWithLoc(itEnv->second);
-			}
-			else if (isReservedLoc(locAbs.getLoc()))
+			if (auto locOpt = resolveLoc(env, locAbs.getLoc()))
 			{
-				absActionWithLoc(locAbs.getLoc());
+				if (!canPop(locOpt.value()))
+				{
+					return park(std::move(env), term, locOpt.value(), false);
+				}
+
+				absActionWithLoc(locOpt.value());
 			}
 			else
 			{
 				machineError("Location abstraction cannot pop from (invalid) location '"
-					+ locAbs.getLoc() + "' !", *this);
+					+ getLocName(locAbs.getLoc()) + "' !", *this);
 			}
 		}
 		else if (term->isVal())
 		{
-			machineError("Value '" + stringifyClosure(closure)
-				+ "' cannot be executed by machine !", *this);
+			std::string value;
+			Printer().printClosure(value, env, term);
+
+			machineError("Value '" + value + "' cannot be executed by machine !", *this);
 		}
 		else if (term->isBinOp())
 		{
 			const BinOpTerm &binOp = term->asBinOp();
 
-			m_Control.push_back(std::make_pair(env, binOp.getBody()));
+			m_Control.push_back(std::make_pair(env, term->getBody()));
 
 			if (auto prim1Opt = tryPopPrim(env, k_LambdaLoc))
 			{
@@ -452,24 +590,21 @@ void Machine::execute(const Program &program)
 		}
 		else if (term->isPrimCases())
 		{
-			const CasesTerm<Prim_t> &cases = term->asPrimCases();
-
-			m_Control.push_back(std::make_pair(env, cases.getBody()));
+			m_Control.push_back(std::make_pair(env, term->getBody()));
 
 			if (auto primOpt = tryPopPrim(env, k_LambdaLoc))
 			{
-				auto itCase = cases.find(primOpt.value());
-				if (itCase != cases.end())
+				if (TermHandle_t caseTerm = term->findPrimCase(primOpt.value()))
 				{
-					m_Control.push_back(std::make_pair(env, itCase->second));
+					m_Control.push_back(std::make_pair(env, caseTerm));
 					
-					m_CallStack.push_back({"Case '" + std::to_string(primOpt.value()) + "'", closure.second});
+					m_CallStack.push_back({CallFrame::PrimCase, k_NoSymbol, primOpt.value(), closure.second});
 				}
 				else
 				{
-					m_Control.push_back(std::make_pair(env, cases.getOtherwise()));
+					m_Control.push_back(std::make_pair(env, term->getOtherwise()));
 					
-					m_CallStack.push_back({"Case 'otherwise'", closure.second});
+					m_CallStack.push_back({CallFrame::Otherwise, k_NoSymbol, 0, closure.second});
 				}
 			}
 			else
@@ -479,22 +614,19 @@ void Machine::execute(const Program &program)
 		}
 		else if (term->isLocCases())
 		{
-			const CasesTerm<Loc_t> &cases = term->asLocCases();
-
-			m_Control.push_back(std::make_pair(env, cases.getBody()));
+			m_Control.push_back(std::make_pair(env, term->getBody()));
 
 			if (auto locOpt = tryPopLoc(env, k_LambdaLoc))
 			{
-				auto itCase = cases.find(locOpt.value());
-				if (itCase != cases.end())
+				if (TermHandle_t caseTerm = term->findLocCase(locOpt.value()))
 				{
-					m_Control.push_back(std::make_pair(env, itCase->second));
-					m_CallStack.push_back({"Case '" + locOpt.value() + "'", closure.second});
+					m_Control.push_back(std::make_pair(env, caseTerm));
+					m_CallStack.push_back({CallFrame::LocCase, locOpt.value(), 0, closure.second});
 				}
 				else
 				{
-					m_Control.push_back(std::make_pair(env, cases.getOtherwise()));	
-					m_CallStack.push_back({"Case 'otherwise'", closure.second});
+					m_Control.push_back(std::make_pair(env, term->getOtherwise()));	
+					m_CallStack.push_back({CallFrame::Otherwise, k_NoSymbol, 0, closure.second});
 				}
 			}
 			else
@@ -502,127 +634,768 @@ void Machine::execute(const Program &program)
 				machineError("Location cases cannot match a non-location value !", *this);
 			}
 		}
-	}
-}
+		else if (term->isBinOpVars())
+		{
+			const BinOpVarsTerm &binOpVars = term->asBinOpVars();
 
-std::optional<Closure_t> Machine::tryPop(Env_t env, Loc_t loc)
-{
-	if (!m_Memory[loc].empty())
-	{
-		Closure_t closure = m_Memory[loc].back();
-		m_Memory[loc].pop_back();
-		return closure;
-	}
-	else
-	{
-		machineError("Cannot pop from empty stack  '"
-			+ loc + "' !", *this);
-	}
+			auto lhsOpt = findPrimBinding(env, binOpVars.getLhs());
+			auto rhsOpt = findPrimBinding(env, binOpVars.getRhs());
 
-	return std::nullopt;
-}
+			if (lhsOpt && rhsOpt && resolveLoc(env, k_LambdaLoc) == k_LambdaLoc)
+			{
+				m_Control.push_back(std::make_pair(env, term->getBody()));
 
-std::optional<Prim_t> Machine::tryPopPrim(Env_t env, Loc_t loc)
-{
-	if (!m_Memory[loc].empty())
-	{
-		if (m_Memory[loc].back().second->isVal())
-		{
-			const ValTerm &val = m_Memory[loc].back().second->asVal();
-			m_Memory[loc].pop_back();
+				Prim_t result = binOpVars.isOp(BinOpTerm::Plus)
+					? lhsOpt.value() + rhsOpt.value()
+					: lhsOpt.value() - rhsOpt.value();
 
-			if (val.isPrim())
+				m_Memory[k_LambdaLoc].push_back(std::make_pair(env, freshTerm(ValTerm(result))));
+			}
+			else
 			{
-				return val.asPrim();
+				// Fall back to the unfused sequence
+				m_Control.push_back(std::make_pair(std::move(env), term->getOriginal()));
 			}
 		}
-	}
-	else
-	{
-		machineError("Cannot pop from empty stack  '"
-			+ loc + "' !", *this);
-	}
-
-	return std::nullopt;
-}
-
-std::optional<Loc_t> Machine::tryPopLoc(Env_t env, Loc_t loc)
-{
-	if (!m_Memory[loc].empty())
-	{
-		if (m_Memory[loc].back().second->isVal())
+		else if (term->isPeekPair())
 		{
-			const ValTerm &val = m_Memory[loc].back().second->asVal();
-			m_Memory[loc].pop_back();
+			const PeekPairTerm &peekPair = term->asPeekPair();
 
-			if (val.isLoc())
+			bool hasPeeked = false;
+
+			auto locOpt = resolveLoc(env, peekPair.getLoc());
+			if (locOpt && !getDevice(locOpt.value()))
 			{
-				return val.asLoc();
-			}
-		}
-	}
-	else
-	{
+				const ClosureStack_t &stack = m_Memory[locOpt.value()];
+
+				if (stack.size() >= 2)
+				{
+					const Closure_t &top = stack[stack.size() - 1];
+					const Closure_t &below = stack[stack.size() - 2];
+
+					if (top.second->isVal() && below.second->isVal() && below.second->asVal().isLoc())
+					{
+						env.first[peekPair.getVar()] = std::make_shared<Closure_t>(top);
+						env.second[peekPair.getLocVar()] = below.second->asVal().asLoc();
+						hasPeeked = true;
+					}
+				}
+			}
+
+			if (hasPeeked)
+			{
+				m_Control.push_back(std::make_pair(std::move(env), term->getBody()));
+			}
+			else
+			{
+				m_Control.push_back(std::make_pair(std::move(env), term->getOriginal()));
+			}
+		}
+		else if (term->isMove())
+		{
+			const MoveTerm &move = term->asMove();
+
+			auto srcOpt = resolveLoc(env, move.getSrcLoc());
+			auto dstOpt = resolveLoc(env, move.getDstLoc());
+
+			// A device which can't be pushed to yet is left to the original
+			// sequence, whose push parks rather than waiting inside the slice
+			if (srcOpt && !getDevice(srcOpt.value()) && !m_Memory[srcOpt.value()].empty() && dstOpt && canPush(dstOpt.value()))
+			{
+				Closure_t value = m_Memory[srcOpt.value()].back();
+				m_Memory[srcOpt.value()].pop_back();
+
+				env.first[move.getVar()] = std::make_shared<Closure_t>(value);
+
+				// Device
+				if (Device *device = getDevice(dstOpt.value()))
+				{
+					if (!device->push(*this, value.first, value.second))
+					{
+						machineError("Application cannot push to '" + getLocName(dstOpt.value()) + "' location !", *this);
+					}
+				}
+				// Generic stack
+				else
+				{
+					if (value.second->isVal())
+					{
+						m_Memory[dstOpt.value()].push_back(value);
+					}
+					else
+					{
+						TermHandle_t arg = term->getOriginal()->getBody()->getArg();
+						m_Memory[dstOpt.value()].push_back(std::make_pair(env, arg));
+					}
+				}
+
+				m_Control.push_back(std::make_pair(std::move(env), term->getBody()));
+			}
+			else
+			{
+				m_Control.push_back(std::make_pair(std::move(env), term->getOriginal()));
+			}
+		}
+	}
+
+	return MachineStatus::Finished;
+}
+
+void Machine::poll()
+{
+	// Definitions are only replaced between steps
+	if (m_Reloader)
+	{
+		m_Reloader->poll();
+	}
+
+	// Spawned machines don't own the output
+	if (!m_IsSpawned)
+	{
+		m_Output->poll();
+	}
+
+	// Nothing is reported, as the results aren't wanted
+	if (m_IsCancelled)
+	{
+		throw MachineError{};
+	}
+}
+
+MachineStatus Machine::park(Env_t &&env, TermHandle_t term, Loc_t loc, bool isPush)
+{
+	// The step is taken again when the machine carries on
+	m_Control.push_back(std::make_pair(std::move(env), term));
+	--m_NumSteps;
+
+	m_WaitingLoc = loc;
+	m_IsWaitingToPush = isPush;
+
+	return MachineStatus::Waiting;
+}
+
+void Machine::notifyWhenReady(std::function<void()> &&wake) const
+{
+	if (isChannelLoc(m_WaitingLoc))
+	{
+		if (ChannelDevice *device = getChannelDevice(m_WaitingLoc))
+		{
+			device->getChannel().addWaiter(m_IsWaitingToPush, std::move(wake));
+			return;
+		}
+	}
+
+	// Nothing it can be told by, so it just looks again
+	wake();
+}
+
+bool Machine::canPush(Loc_t loc) const
+{
+	if (m_CanBlock)
+	{
+		return true;
+	}
+
+	Device *device = getDevice(loc);
+	return !device || device->canPush(*this);
+}
+
+bool Machine::canPop(Loc_t loc) const
+{
+	if (m_CanBlock)
+	{
+		return true;
+	}
+
+	Device *device = getDevice(loc);
+	return !device || device->canPop(*this);
+}
+
+std::optional<Closure_t> Machine::tryPop(const Env_t &env, Loc_t loc)
+{
+	if (!m_Spawns.empty() && m_Memory[loc].empty())
+	{
+		tryJoin(loc);
+	}
+
+	if (!m_Memory[loc].empty())
+	{
+		Closure_t closure = m_Memory[loc].back();
+		m_Memory[loc].pop_back();
+		return closure;
+	}
+	else
+	{
+		machineError("Cannot pop from empty stack  '"
+			+ getLocName(loc) + "' !", *this);
+	}
+
+	return std::nullopt;
+}
+
+std::optional<Prim_t> Machine::tryPopPrim(const Env_t &env, Loc_t loc)
+{
+	if (!m_Spawns.empty() && m_Memory[loc].empty())
+	{
+		tryJoin(loc);
+	}
+
+	if (!m_Memory[loc].empty())
+	{
+		if (m_Memory[loc].back().second->isVal())
+		{
+			const ValTerm &val = m_Memory[loc].back().second->asVal();
+			m_Memory[loc].pop_back();
+
+			if (val.isPrim())
+			{
+				return val.asPrim();
+			}
+		}
+	}
+	else
+	{
 		machineError("Cannot pop from empty stack  '"
-			+ loc + "' !", *this);
+			+ getLocName(loc) + "' !", *this);
 	}
 
 	return std::nullopt;
 }
 
+std::optional<Loc_t> Machine::tryPopLoc(const Env_t &env, Loc_t loc)
+{
+	if (!m_Spawns.empty() && m_Memory[loc].empty())
+	{
+		tryJoin(loc);
+	}
+
+	if (!m_Memory[loc].empty())
+	{
+		if (m_Memory[loc].back().second->isVal())
+		{
+			const ValTerm &val = m_Memory[loc].back().second->asVal();
+			m_Memory[loc].pop_back();
+
+			if (val.isLoc())
+			{
+				return val.asLoc();
+			}
+		}
+	}
+	else
+	{
+		machineError("Cannot pop from empty stack  '"
+			+ getLocName(loc) + "' !", *this);
+	}
+
+	return std::nullopt;
+}
+
+std::optional<TermHandle_t> Machine::loadFunc(const Program &program, Var_t funcName)
+{
+	try
+	{
+		return program.load(funcName);
+	}
+	catch (const LoadError &error)
+	{
+		machineError(nestReport("Definition of '" + getSymbolName(funcName) + "' cannot be parsed !", error.Report), *this);
+	}
+
+	return std::nullopt;
+}
+
+bool Machine::tryRunLoop(const Loop &loop)
+{
+	ClosureStack_t &stack = m_Memory[k_LambdaLoc];
+
+	if (stack.size() < loop.getArity())
+	{
+		return false;
+	}
+
+	// Drop back to the general machine unless every argument is a primitive
+	std::vector<Prim_t> args;
+	for (size_t i = 0; i < loop.getArity(); ++i)
+	{
+		const Closure_t &closure = stack[stack.size() - 1 - i];
+
+		if (!closure.second->isVal() || !closure.second->asVal().isPrim())
+		{
+			return false;
+		}
+
+		args.push_back(closure.second->asVal().asPrim());
+	}
+
+	stack.resize(stack.size() - loop.getArity());
+
+	// Each iteration is charged as a step, and the loop stops at the end of
+	// the slice (or the step limit) and at the next poll, where the general
+	// machine carries on from the call it stopped at
+	uint64_t numIters = std::min<uint64_t>(m_EndStep - m_NumSteps, s_PollInterval - m_NumSteps % s_PollInterval);
+	auto resultsOpt = loop.run(args, numIters);
+	m_NumSteps += numIters;
+
+	if (resultsOpt)
+	{
+		for (Prim_t result : resultsOpt.value())
+		{
+			stack.push_back(std::make_pair(Env_t{}, freshTerm(ValTerm(result))));
+		}
+	}
+	else
+	{
+		for (size_t i = args.size(); i > 0; --i)
+		{
+			stack.push_back(std::make_pair(Env_t{}, freshTerm(ValTerm(args[i - 1]))));
+		}
+	}
+
+	// The loop isn't used after polling, as reloading may replace it
+	if (numIters && m_NumSteps % s_PollInterval == 0)
+	{
+		poll();
+	}
+
+	return resultsOpt.has_value();
+}
+
+bool Machine::tryRunHostFunc(const HostFunc &hostFunc)
+{
+	const std::vector<Loc_t> &argLocs = hostFunc.getArgLocs();
+	const std::vector<Loc_t> &resultLocs = hostFunc.getResultLocs();
+
+	if (m_IsSpawned)
+	{
+		for (Loc_t loc : argLocs)
+		{
+			checkSpawnedLoc(loc);
+		}
+		for (Loc_t loc : resultLocs)
+		{
+			checkSpawnedLoc(loc);
+		}
+	}
+
+	m_HostArgs.resize(argLocs.size());
+	m_HostResults.assign(resultLocs.size(), 0);
+
+	// Drop back to the program function unless every argument is a primitive
+	// (those of devices can't be checked without popping them)
+	for (size_t i = 0; i < argLocs.size(); ++i)
+	{
+		if (getDevice(argLocs[i]))
+		{
+			continue;
+		}
+
+		// Arguments from the same location are taken from the top down
+		size_t depth = std::count(argLocs.begin(), argLocs.begin() + i, argLocs[i]);
+
+		const ClosureStack_t &stack = m_Memory[argLocs[i]];
+		if (stack.size() <= depth)
+		{
+			return false;
+		}
+
+		const Closure_t &closure = stack[stack.size() - 1 - depth];
+		if (!closure.second->isVal() || !closure.second->asVal().isPrim())
+		{
+			return false;
+		}
+
+		m_HostArgs[i] = closure.second->asVal().asPrim();
+	}
+
+	for (size_t i = 0; i < argLocs.size(); ++i)
+	{
+		if (Device *device = getDevice(argLocs[i]))
+		{
+			auto closureOpt = device->pop(*this);
+			if (!closureOpt || !closureOpt->second->isVal() || !closureOpt->second->asVal().isPrim())
+			{
+				machineError("Host function cannot pop a primitive from '" + getLocName(argLocs[i]) + "' location !", *this);
+			}
+
+			m_HostArgs[i] = closureOpt->second->asVal().asPrim();
+		}
+		else
+		{
+			m_Memory[argLocs[i]].pop_back();
+		}
+	}
+
+	hostFunc.call(m_HostArgs, m_HostResults);
+
+	for (size_t i = 0; i < resultLocs.size(); ++i)
+	{
+		TermHandle_t result = freshTerm(ValTerm(m_HostResults[i]));
+
+		if (Device *device = getDevice(resultLocs[i]))
+		{
+			if (!device->push(*this, Env_t{}, result))
+			{
+				machineError("Host function cannot push to '" + getLocName(resultLocs[i]) + "' location !", *this);
+			}
+		}
+		else
+		{
+			m_Memory[resultLocs[i]].push_back(std::make_pair(Env_t{}, result));
+		}
+	}
+
+	return true;
+}
+
 TermHandle_t Machine::freshTerm(Term &&term)
 {
-	m_FreshTerms.push_back(newTerm(std::move(term)));	
-	return m_FreshTerms.back();
+	m_FreshTerms.push_back(std::move(term));
+	return &m_FreshTerms.back();
+}
+
+Loc_t Machine::freshLoc()
+{
+	Loc_t loc = getFreshLoc(m_NumFreshLocs++);
+	m_Memory[loc] = {};
+	return loc;
+}
+
+Loc_t Machine::spawn(const Env_t &env, TermHandle_t term)
+{
+	Loc_t loc = freshLoc();
+
+	Spawn &spawn = m_Spawns[loc];
+	spawn.Child = std::make_unique<Machine>();
+
+	Machine &child = *spawn.Child;
+	child.m_IsSpawned = true;
+	child.m_IsLoopsEnabled = m_IsLoopsEnabled;
+	child.m_MaxSteps = m_MaxSteps;
+
+	// Started here, so the task only ever runs slices of it
+	child.m_Program = m_Program;
+	child.m_CallStack.push_back({CallFrame::Spawned, k_NoSymbol, 0, term});
+	child.m_Control.push_back(std::make_pair(env, term));
+	child.m_Status = MachineStatus::Paused;
+
+	// Elements of the map stay put when others are added or removed
+	spawn.Task = WorkStealingPool::getShared().push(
+		[&child](const WorkStealingPool::Wake_t &wake) {
+			return child.runSpawned(wake);
+		}
+	);
+
+	return loc;
+}
+
+void Machine::tryJoin(Loc_t loc)
+{
+	auto itSpawn = m_Spawns.find(loc);
+	if (itSpawn == m_Spawns.end())
+	{
+		return;
+	}
+
+	Spawn &spawn = itSpawn->second;
+	WorkStealingPool::getShared().join(spawn.Task);
+
+	Machine &child = *spawn.Child;
+	if (child.m_Status == MachineStatus::Error)
+	{
+		std::string message = nestReport("Closure spawned to '" + getLocName(loc) + "' failed !", child.m_Error.value_or(""));
+
+		m_Spawns.erase(itSpawn);
+		machineError(message, *this);
+	}
+
+	// The results may hold terms created by the child, so those are kept
+	m_Memory[loc] = std::move(child.m_Memory[k_LambdaLoc]);
+	m_JoinedTerms.push_back(std::move(child.m_FreshTerms));
+
+	m_Spawns.erase(itSpawn);
+}
+
+void Machine::stopSpawns()
+{
+	if (m_Spawns.empty())
+	{
+		return;
+	}
+
+	WorkStealingPool &pool = WorkStealingPool::getShared();
+
+	// Children waiting on a channel are woken to see they've been stopped
+	for (auto &[loc, spawn] : m_Spawns)
+	{
+		spawn.Child->m_IsCancelled = true;
+		pool.wake(spawn.Task);
+	}
+
+	for (auto &[loc, spawn] : m_Spawns)
+	{
+		pool.join(spawn.Task);
+	}
+
+	m_Spawns.clear();
+}
+
+void Machine::checkSpawnedLoc(Loc_t loc) const
+{
+	if (loc != k_LambdaLoc && !isChannelLoc(loc))
+	{
+		machineError("Spawned closures can only use the 'lambda' location (and channels), not '"
+			+ getLocName(loc) + "' !", *this);
+	}
+}
+
+Device *Machine::getDevice(Loc_t loc) const
+{
+	if (loc < m_Devices.size())
+	{
+		return m_Devices[loc].get();
+	}
+	else if (isChannelLoc(loc))
+	{
+		return getChannelDevice(loc);
+	}
+	return nullptr;
+}
+
+ChannelDevice *Machine::getChannelDevice(Loc_t loc) const
+{
+	auto itDevice = m_ChannelDevices.find(loc);
+	if (itDevice != m_ChannelDevices.end())
+	{
+		return itDevice->second.get();
+	}
+
+	if (auto channel = Channel::find(loc))
+	{
+		auto &device = m_ChannelDevices[loc];
+		device = std::make_unique<ChannelDevice>(std::move(channel));
+		return device.get();
+	}
+	return nullptr;
+}
+
+std::optional<Loc_t> Machine::resolveLoc(const Env_t &env, Loc_t loc) const
+{
+	auto itEnv = env.second.find(loc);
+
+	// Spawned machines have nothing but 'lambda'
+	if (m_IsSpawned)
+	{
+		Loc_t resolved = (itEnv != env.second.end()) ? itEnv->second : loc;
+		checkSpawnedLoc(resolved);
+		return resolved;
+	}
+
+	if (itEnv != env.second.end())
+	{
+		return itEnv->second;
+	}
+	// Unbound locations are only valid when they're reserved
+	else if (loc == k_LambdaLoc || getDevice(loc))
+	{
+		return loc;
+	}
+	return std::nullopt;
+}
+
+void Machine::setProfiling(bool isEnabled)
+{
+	m_IsProfiling = isEnabled;
+}
+
+void Machine::setLoops(bool isEnabled)
+{
+	m_IsLoopsEnabled = isEnabled;
+}
+
+void Machine::setReloader(Reloader *reloader)
+{
+	m_Reloader = reloader;
+}
+
+void Machine::setMaxSteps(uint64_t maxSteps)
+{
+	m_MaxSteps = maxSteps ? maxSteps : UINT64_MAX;
+}
+
+uint64_t Machine::getNumSteps() const
+{
+	return m_NumSteps;
+}
+
+void Machine::setOutput(OutputSink &output)
+{
+	m_Output = &output;
+}
+
+OutputSink &Machine::getOutput() const
+{
+	return *m_Output;
+}
+
+void Machine::setInput(InputSource &input)
+{
+	m_Input = &input;
+}
+
+InputSource &Machine::getInput() const
+{
+	return *m_Input;
+}
+
+void Machine::error(const std::string &message) const
+{
+	machineError(message, *this);
+}
+
+const std::atomic<bool> &Machine::getStopFlag() const
+{
+	return m_IsCancelled;
+}
+
+bool Machine::isSpawned() const
+{
+	return m_IsSpawned;
+}
+
+void Machine::profileTerm(const TermHandle_t &term)
+{
+	constexpr size_t k_NumKinds = Term::s_NumKinds;
+
+	TermHandle_t second = term->getBody();
+	if (!second || second->isNil())
+	{
+		return;
+	}
+
+	size_t pair = term->getKindIndex() * k_NumKinds + second->getKindIndex();
+	m_PairCounts[pair]++;
+
+	TermHandle_t third = second->getBody();
+	if (!third || third->isNil())
+	{
+		return;
+	}
+
+	m_TripleCounts[pair * k_NumKinds + third->getKindIndex()]++;
 }
 
 std::string Machine::getStackDebug() const
 {
-	std::stringstream ss;
+	std::string str = "---- Stacks ----\n";
 
-	ss << "---- Stacks ----" << '\n';
+	Printer printer;
+	printer.setMaxSize(s_DebugMaxSize);
+	printer.setMaxDepth(s_DebugMaxDepth);
 
 	for (auto itMemory = m_Memory.begin(); itMemory != m_Memory.end(); ++itMemory)
 	{
 		if (auto idOpt = getIdFromReservedLoc(itMemory->first))
 		{
-			ss << "  -- (Reserved) Location " << idOpt.value() << '\n';
+			str += "  -- (Reserved) Location " + idOpt.value() + '\n';
 		}
 		else
 		{
-			ss << "  -- Location " << itMemory->first << '\n';
+			str += "  -- Location " + getLocName(itMemory->first) + '\n';
 		}
 
 		for (auto itStack = itMemory->second.rbegin(); itStack != itMemory->second.rend(); ++itStack)
 		{
-			ss << "    " << stringifyClosure(*itStack) << '\n';
+			str += "    ";
+			printer.printClosure(str, *itStack);
+			str += '\n';
 		}
 
 		auto itMemoryCopy = itMemory;
 		if (!(++itMemoryCopy == m_Memory.end()))
 		{
-			ss << '\n';
+			str += '\n';
 		}
 	}
 
-	ss << "--------------------";
+	str += "--------------------";
 
-	return ss.str();
+	return str;
 }
 
 std::string Machine::getCallstackDebug() const
 {
-	std::stringstream ss;
+	std::string str = "---- Call Stack ----\n";
 
-	ss << "---- Call Stack ----" << '\n';
+	Printer printer;
+	printer.setMaxSize(s_DebugMaxSize);
+	printer.setMaxDepth(s_DebugMaxDepth);
 
 	for (auto itCallStack = m_CallStack.rbegin(); itCallStack != m_CallStack.rend(); ++itCallStack)
 	{
-		ss << std::string(m_CallStack.size() - (m_CallStack.rend() - itCallStack), ' ');
-		ss << "> " << itCallStack->first << " => " << stringifyTerm(itCallStack->second) << "\n";
+		str.append(m_CallStack.size() - (m_CallStack.rend() - itCallStack), ' ');
+		str += "> " + getCallName(*itCallStack) + " => ";
+		printer.printTerm(str, itCallStack->Callee);
+		str += '\n';
+	}
+
+	str += "---------------";
+
+	return str;
+}
+
+std::string Machine::getProfileDebug() const
+{
+	constexpr size_t k_NumKinds = Term::s_NumKinds;
+	constexpr size_t k_MaxRows = 16;
+
+	auto writeCounts = [&](const uint64_t *counts, size_t numCounts, size_t arity, std::stringstream &ss) {
+		std::vector<size_t> order;
+		for (size_t i = 0; i < numCounts; ++i)
+		{
+			if (counts[i] > 0)
+			{
+				order.push_back(i);
+			}
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return counts[a] > counts[b];
+		});
+
+		for (size_t row = 0; row < order.size() && row < k_MaxRows; ++row)
+		{
+			std::string kinds;
+			for (size_t i = 0, idx = order[row]; i < arity; ++i, idx /= k_NumKinds)
+			{
+				kinds = stringifyTermKind(idx % k_NumKinds) + (i > 0 ? " . " : "") + kinds;
+			}
+
+			ss << "    " << counts[order[row]] << "  " << kinds << '\n';
+		}
+	};
+
+	std::stringstream ss;
+
+	ss << "---- Profile ----" << '\n';
+	ss << "  -- Pairs" << '\n';
+	writeCounts(m_PairCounts.data(), m_PairCounts.size(), 2, ss);
+	ss << '\n';
+	ss << "  -- Triples" << '\n';
+	writeCounts(m_TripleCounts.data(), m_TripleCounts.size(), 3, ss);
+
+	if (!m_ChannelDevices.empty())
+	{
+		ss << '\n';
+		ss << "  -- Channels" << '\n';
+
+		for (const auto &[loc, device] : m_ChannelDevices)
+		{
+			ss << "    " << getLocName(loc) << "  " << device->getChannel().getStatsDebug() << '\n';
+		}
 	}
 
-	ss << "---------------";
+	ss << "-----------------";
 
 	return ss.str();
 }
\ No newline at end of file
@@ -2,10 +2,23 @@
 
 #include <unordered_map>
 #include <vector>
+#include <deque>
 #include <utility>
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <atomic>
+#include <functional>
+#include <cinttypes>
 
 #include "Term.hpp"
 #include "Parser.hpp"
+#include "Reloader.hpp"
+#include "Output.hpp"
+#include "Input.hpp"
+#include "WorkStealingPool.hpp"
 
 // Ouch.. using a void pointer here is rough :/
 using VarEnv_t = std::unordered_map<Var_t, std::shared_ptr<void>>;
@@ -16,22 +29,165 @@ using Closure_t = std::pair<Env_t, TermHandle_t>;
 using ClosureStack_t = std::vector<Closure_t>;
 using ClosureMemory_t = std::unordered_map<Loc_t, ClosureStack_t>;
 
-using Callstack_t = std::vector<std::pair<std::string, TermHandle_t>>;
+// Entry of the call stack, which is only named when it's displayed (so calls
+// don't look up the symbol table)
+struct CallFrame
+{
+	enum Kind
+	{
+		Main, Spawned, Func, Binding, PrimCase, LocCase, Otherwise
+	};
+
+	Kind Type;
+	// Variable of 'Func' & 'Binding', location of 'LocCase'
+	Symbol_t Symbol;
+	// Primitive of 'PrimCase'
+	Prim_t Prim;
+	TermHandle_t Callee;
+};
+
+using Callstack_t = std::vector<CallFrame>;
+
+class Device;
+class ChannelDevice;
+
+// State of a machine which is run in slices, see 'Machine::run'
+enum class MachineStatus
+{
+	// Ran to the end of 'main'
+	Finished,
+	// Ran out of steps for the slice, so it carries on with the next
+	Paused,
+	// The next step would wait for input (or on a channel)
+	Waiting,
+	// Stopped by an error, see 'Machine::getError'
+	Error
+};
 
 class Machine
 {
 public:
+	// 'new', 'in', 'out', 'null', 'spawn' & 'chan' are built-in devices, see
+	// 'Device.hpp'
+	Machine();
+	~Machine();
+
+	// Runs 'main' of the program, displaying any error & exiting
 	void execute(const Program &funcs);
+	// As 'execute', though an error is returned (as the report which would've
+	// been displayed) rather than exiting. The program isn't changed by running
+	// it, so it can be shared by any number of machines.
+	std::optional<std::string> tryExecute(const Program &program);
+
+	// Loads 'main' of the program to be run in slices, by calling 'run' until
+	// it's finished (the program must outlive the run). Any run in progress is
+	// dropped.
+	void start(const Program &program);
+	// Runs at most 'maxSteps' steps (0 is no limit), returning early when the
+	// machine finishes, fails, or would have to wait for input (or on a
+	// channel) rather than blocking. Any number of machines can take turns
+	// on a thread this way, calling 'run' again to carry on where they were.
+	MachineStatus run(uint64_t maxSteps);
+	// As 'run', though waiting for input blocks (for when nothing else can run)
+	MachineStatus resume(uint64_t maxSteps);
+
+	MachineStatus getStatus() const;
+	// Report of the error which stopped the machine, as 'tryExecute' returns
+	const std::optional<std::string> &getError() const;
+
+	// Pushes & pops of the location named 'name' are handled by the device
+	// (replacing any device already added for it), false for 'lambda'
+	bool addDevice(std::string_view name, std::unique_ptr<Device> &&device);
+
+	// Counts adjacent term kinds (pairs & triples) as they're executed
+	void setProfiling(bool isEnabled);
+
+	// Runs calls to compiled loops natively, see 'Loop.hpp'
+	void setLoops(bool isEnabled);
+
+	// Polls for changes to the program every so many steps, see 'Reloader'
+	void setReloader(Reloader *reloader);
+
+	// Running more than this many steps is an error (0 is no limit, the default)
+	void setMaxSteps(uint64_t maxSteps);
+	// Steps run by the last execution
+	uint64_t getNumSteps() const;
+
+	// Values pushed to 'out' are written to the sink (stdout by default)
+	void setOutput(OutputSink &output);
+	OutputSink &getOutput() const;
+
+	// Words read from 'in' (stdin by default)
+	void setInput(InputSource &input);
+	InputSource &getInput() const;
+
+	// For devices, terms & locations which are owned by the machine
+	TermHandle_t freshTerm(Term &&term);
+	Loc_t freshLoc();
+
+	// Runs the closure on a child machine, concurrently with this one, giving
+	// the (fresh) location its results are joined to. The child has nothing but
+	// a 'lambda' stack of its own, so using any other location (other than a
+	// channel) is an error.
+	// Popping from the location while it's empty waits for the child to finish,
+	// and fills it with the child's 'lambda' stack.
+	Loc_t spawn(const Env_t &env, TermHandle_t term);
+
+	// Stops the machine with the error, see 'execute'
+	void error(const std::string &message) const;
+
+	// Set when a spawned machine is stopped (from another thread), for devices
+	// which wait
+	const std::atomic<bool> &getStopFlag() const;
+	// Spawned machines share the output of the one they were spawned from
+	bool isSpawned() const;
 
 	std::string getStackDebug() const;
 	std::string getCallstackDebug() const;
+	std::string getProfileDebug() const;
 
 private:
-	std::optional<Closure_t> tryPop(Env_t env, Loc_t loc);
-	std::optional<Prim_t> tryPopPrim(Env_t env, Loc_t loc);
-	std::optional<Loc_t> tryPopLoc(Env_t env, Loc_t loc);
+	MachineStatus runSlice(uint64_t maxSteps, bool canBlock);
+	// Runs until the control stack is empty (or the slice is over)
+	MachineStatus runControl(uint64_t maxSteps);
+	// Polls the reloader & checks whether the machine was stopped
+	void poll();
+	// Puts the step back, to be taken once the location can be pushed to (or
+	// popped from)
+	MachineStatus park(Env_t &&env, TermHandle_t term, Loc_t loc, bool isPush);
+	// Calls 'wake' once the location the machine parked on may be ready
+	void notifyWhenReady(std::function<void()> &&wake) const;
 
-	TermHandle_t freshTerm(Term &&term);
+	// Whether the location can be pushed to (or popped from) without waiting
+	bool canPush(Loc_t loc) const;
+	bool canPop(Loc_t loc) const;
+	// Runs a slice of a spawned machine, which parks rather than holding its
+	// worker while it waits on a channel
+	WorkStealingPool::Step runSpawned(const WorkStealingPool::Wake_t &wake);
+
+	// Waits for the child spawned to the location, if any, taking its results
+	void tryJoin(Loc_t loc);
+	// Stops (& waits for) every child which hasn't been joined
+	void stopSpawns();
+
+	std::optional<Closure_t> tryPop(const Env_t &env, Loc_t loc);
+	std::optional<Prim_t> tryPopPrim(const Env_t &env, Loc_t loc);
+	std::optional<Loc_t> tryPopLoc(const Env_t &env, Loc_t loc);
+
+	Device *getDevice(Loc_t loc) const;
+	ChannelDevice *getChannelDevice(Loc_t loc) const;
+
+	// Location a (possibly bound) location refers to, if it's valid
+	std::optional<Loc_t> resolveLoc(const Env_t &env, Loc_t loc) const;
+
+	// Errors in lazily parsed definitions are errors of the machine
+	std::optional<TermHandle_t> loadFunc(const Program &program, Var_t funcName);
+
+	bool tryRunLoop(const Loop &loop);
+	bool tryRunHostFunc(const HostFunc &hostFunc);
+	void checkSpawnedLoc(Loc_t loc) const;
+
+	void profileTerm(const TermHandle_t &term);
 
 private:
 	ClosureMemory_t m_Memory;
@@ -39,5 +195,64 @@ private:
 
 	Callstack_t m_CallStack;
 
-	std::vector<TermOwner_t> m_FreshTerms;
+	// Terms created while running (deques so handles to them stay valid)
+	std::deque<Term> m_FreshTerms;
+
+	// Indexed by location, nullptr for locations which are stacks
+	std::vector<std::unique_ptr<Device>> m_Devices;
+	// Channels aren't symbols, so they're found by location when first used
+	mutable std::unordered_map<Loc_t, std::unique_ptr<ChannelDevice>> m_ChannelDevices;
+
+	uint32_t m_NumFreshLocs = 0;
+
+	// Reused for the arguments & results of each call of a host function
+	std::vector<Prim_t> m_HostArgs;
+	std::vector<Prim_t> m_HostResults;
+
+	// Children which haven't been joined, by the location they're joined to
+	struct Spawn
+	{
+		std::unique_ptr<Machine> Child;
+		WorkStealingPool::TaskHandle_t Task;
+	};
+	std::unordered_map<Loc_t, Spawn> m_Spawns;
+	// Terms created by children which were joined, as their results use them
+	std::vector<std::deque<Term>> m_JoinedTerms;
+
+	// Program being run, for spawning
+	const Program *m_Program = nullptr;
+
+	bool m_IsSpawned = false;
+	std::atomic<bool> m_IsCancelled = false;
+
+	MachineStatus m_Status = MachineStatus::Finished;
+	std::optional<std::string> m_Error;
+	// False while running a slice with 'run'
+	bool m_CanBlock = true;
+	// Location the machine parked on while 'Waiting'
+	Loc_t m_WaitingLoc = 0;
+	bool m_IsWaitingToPush = false;
+
+	uint64_t m_NumSteps = 0;
+	uint64_t m_MaxSteps = UINT64_MAX;
+	// Step the current slice ends at (the step limit if it comes first)
+	uint64_t m_EndStep = UINT64_MAX;
+
+	bool m_IsProfiling = false;
+	bool m_IsLoopsEnabled = true;
+
+	OutputSink *m_Output = &OutputSink::getStdout();
+	InputSource *m_Input = &InputSource::getStdin();
+
+	Reloader *m_Reloader = nullptr;
+	// Steps between polling the reloader & checking for cancellation
+	static const uint32_t s_PollInterval = 1 << 16;
+	// Steps a spawned machine runs before the others on its worker get a turn
+	static const uint32_t s_SpawnSlice = 1 << 16;
+
+	// Values in debug output are cut short beyond these
+	static const size_t s_DebugMaxSize = 4 * 1024;
+	static const size_t s_DebugMaxDepth = 256;
+	std::array<uint64_t, Term::s_NumKinds * Term::s_NumKinds> m_PairCounts = {};
+	std::array<uint64_t, Term::s_NumKinds * Term::s_NumKinds * Term::s_NumKinds> m_TripleCounts = {};
 };
\ No newline at end of file
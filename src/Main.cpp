@@ -1,14 +1,34 @@
 #include <string>
 #include <string_view>
+#include <optional>
 #include <sstream>
-#include <fstream>
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <unordered_map>
+#include <memory>
 
 #include "Lexer.hpp"
 #include "Parser.hpp"
 #include "Program.hpp"
 #include "Machine.hpp"
 #include "Utils.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "Image.hpp"
+#include "Module.hpp"
+#include "Reloader.hpp"
+#include "Output.hpp"
+#include "Input.hpp"
+#include "Device.hpp"
+#include "MappedStack.hpp"
+#include "Batch.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 // --- Basics ---
 
@@ -60,24 +80,37 @@ main  = (new<@a> . [5]a . new<@b> . [2]b . [#a] . get . print . [#b] . get . pri
 
 struct Args
 {
-	std::string Source;
+	// Either the mapped file or the '--source' argument
+	std::string_view Source;
+	std::optional<MappedFile> File;
+	// Imported modules are relative to the file
+	std::string Dir = ".";
+	std::string Path;
+
 	bool Debug = false;
+	bool Profile = false;
+	bool Fusion = true;
+	bool Loops = true;
+	bool ShareTerms = false;
+	bool Lazy = false;
+	bool Lex = false;
+	bool Parse = false;
+	size_t Threads = ThreadPool::getHardwareThreads();
+	std::optional<std::string> Compile;
+	std::optional<std::string> CacheDir;
+	bool Watch = false;
+	std::optional<OutputSink::FlushPolicy> Flush;
+	bool AsyncOutput = false;
+	bool BinaryIo = false;
+	std::optional<MappedFile> Input;
+	// Locations & the files their stacks are loaded from or dumped to
+	std::vector<std::pair<std::string, std::string>> Loads;
+	std::vector<std::pair<std::string, std::string>> Dumps;
+	// Directory of inputs to run the program with, see 'BatchRunner'
+	std::optional<std::string> BatchDir;
+	size_t Jobs = ThreadPool::getHardwareThreads();
 };
 
-static std::optional<std::string> readFile(const std::string &path)
-{
-	std::ifstream ifs(path);
-
-	if (!ifs.is_open())
-	{
-		return std::nullopt;
-	}
-
-	std::stringstream buffer;
-	buffer << ifs.rdbuf();
-	return buffer.str();
-}
-
 static Args parseArgs(int argc, char **argv)
 {
 	Args args;
@@ -85,7 +118,7 @@ static Args parseArgs(int argc, char **argv)
 
 	auto fail = [](std::string msg) {
 		std::cerr << msg << std::endl;
-		std::cerr << "Usage: cfmc [--help] [--debug] [--file path | --source src]" << std::endl;
+		std::cerr << "Usage: cfmc [--help] [--debug] [--profile] [--no-fusion] [--no-loops] [--share-terms] [--lazy] [--lex] [--parse] [--threads n] [--compile path] [--cache dir] [--watch] [--flush line|size|time|exit] [--async-output] [--io text|binary] [--input path] [--load loc=path] [--dump loc=path] [--batch dir] [--jobs n] [--file path | --source src]" << std::endl;
 		std::exit(1);
 	};
 
@@ -101,14 +134,158 @@ static Args parseArgs(int argc, char **argv)
 		{
 			args.Debug = true;
 		}
+		else if (arg == "--profile")
+		{
+			args.Profile = true;
+		}
+		else if (arg == "--no-fusion")
+		{
+			args.Fusion = false;
+		}
+		else if (arg == "--no-loops")
+		{
+			args.Loops = false;
+		}
+		else if (arg == "--share-terms")
+		{
+			args.ShareTerms = true;
+		}
+		else if (arg == "--lazy")
+		{
+			args.Lazy = true;
+		}
+		else if (arg == "--lex")
+		{
+			args.Lex = true;
+		}
+		else if (arg == "--parse")
+		{
+			args.Parse = true;
+		}
+		else if (arg == "--threads")
+		{
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+			{
+				args.Threads = std::atoi(argv[++i]);
+			}
+			else
+			{
+				fail("Expected number of threads after '--threads'.");
+			}
+		}
+		else if (arg == "--watch")
+		{
+			args.Watch = true;
+		}
+		else if (arg == "--flush")
+		{
+			std::string policy = (i + 1 < argc) ? argv[++i] : "";
+
+			if      (policy == "line") { args.Flush = OutputSink::FlushPolicy::Line; }
+			else if (policy == "size") { args.Flush = OutputSink::FlushPolicy::Size; }
+			else if (policy == "time") { args.Flush = OutputSink::FlushPolicy::Time; }
+			else if (policy == "exit") { args.Flush = OutputSink::FlushPolicy::Exit; }
+			else
+			{
+				fail("Expected 'line', 'size', 'time' or 'exit' after '--flush'.");
+			}
+		}
+		else if (arg == "--async-output")
+		{
+			args.AsyncOutput = true;
+		}
+		else if (arg == "--io")
+		{
+			std::string format = (i + 1 < argc) ? argv[++i] : "";
+
+			if      (format == "text")   { args.BinaryIo = false; }
+			else if (format == "binary") { args.BinaryIo = true; }
+			else
+			{
+				fail("Expected 'text' or 'binary' after '--io'.");
+			}
+		}
+		else if (arg == "--input")
+		{
+			if (i + 1 < argc && (args.Input = MappedFile::open(argv[i + 1])))
+			{
+				i++;
+			}
+			else
+			{
+				fail("Expected readable file after '--input'.");
+			}
+		}
+		else if (arg == "--load" || arg == "--dump")
+		{
+			std::string_view binding = (i + 1 < argc) ? argv[i + 1] : "";
+			size_t equals = binding.find('=');
+
+			if (equals != std::string_view::npos && equals > 0 && equals + 1 < binding.size())
+			{
+				auto &bindings = (arg == "--load") ? args.Loads : args.Dumps;
+				bindings.emplace_back(binding.substr(0, equals), binding.substr(equals + 1));
+				i++;
+			}
+			else
+			{
+				fail("Expected 'loc=path' after '" + arg + "'.");
+			}
+		}
+		else if (arg == "--batch")
+		{
+			if (i + 1 < argc && std::filesystem::is_directory(argv[i + 1]))
+			{
+				args.BatchDir = argv[++i];
+			}
+			else
+			{
+				fail("Expected readable directory of inputs after '--batch'.");
+			}
+		}
+		else if (arg == "--jobs")
+		{
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+			{
+				args.Jobs = std::atoi(argv[++i]);
+			}
+			else
+			{
+				fail("Expected number of jobs after '--jobs'.");
+			}
+		}
+		else if (arg == "--compile")
+		{
+			if (i + 1 < argc)
+			{
+				args.Compile = argv[++i];
+			}
+			else
+			{
+				fail("Expected path of image after '--compile'.");
+			}
+		}
+		else if (arg == "--cache")
+		{
+			if (i + 1 < argc)
+			{
+				args.CacheDir = argv[++i];
+			}
+			else
+			{
+				fail("Expected directory after '--cache'.");
+			}
+		}
 		if (arg == "--file" && !isSrcSpecified)
 		{
 			if (i + 1 < argc)
 			{
 				std::string path = argv[i + 1];
-				if (auto sourceOpt = readFile(path))
+				if ((args.File = MappedFile::open(path)))
 				{
-					args.Source = sourceOpt.value();
+					args.Source = args.File->getView();
+					args.Dir = std::filesystem::path(path).parent_path().string();
+					args.Path = path;
 					isSrcSpecified = true;
 				}
 				else
@@ -127,8 +304,7 @@ static Args parseArgs(int argc, char **argv)
 		{
 			if (i + 1 < argc)
 			{
-				std::string source = argv[i + 1];
-				args.Source = source;
+				args.Source = argv[i + 1];
 				isSrcSpecified = true;
 			}
 			else
@@ -143,16 +319,238 @@ static Args parseArgs(int argc, char **argv)
 		fail("No file or source is specified.");
 	}
 
+	if (args.Watch && (!args.File || Image::isImage(args.Source)))
+	{
+		fail("Only programs given as a source file can be watched.");
+	}
+
+	if (args.BatchDir && (args.Watch || args.Input || !args.Loads.empty() || !args.Dumps.empty()))
+	{
+		fail("Batches can't be watched, or given other input or stacks.");
+	}
+
 	return args;
 }
 
+// Lexes the whole source, displaying the number of tokens & the throughput
+static void lexSource(std::string_view source)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	size_t numTokens = 0;
+
+	Lexer lexer(source);
+	while (!lexer.isPeekToken(Token::Eof))
+	{
+		lexer.next();
+		numTokens++;
+	}
+
+	std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+	double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+
+	std::cout << "---- Lexer ----" << '\n';
+	std::cout << "  -- " << numTokens << " tokens in " << source.size() << " bytes" << '\n';
+	std::cout << "  -- " << seconds.count() * 1000.0 << " ms (" << megabytes / seconds.count() << " MB/s)" << '\n';
+	std::cout << "---------------" << std::endl;
+}
+
+// Parses the whole source, displaying the number of terms & the throughput
+static void parseSource(Parser &parser, std::string_view source, size_t numThreads)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Program program = parser.parseProgram(source);
+
+	std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+	double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+
+	std::cout << "---- Parser ----" << '\n';
+	std::cout << "  -- " << source.size() << " bytes on " << numThreads << " thread(s)" << '\n';
+	std::cout << "  -- " << seconds.count() * 1000.0 << " ms (" << megabytes / seconds.count() << " MB/s)" << '\n';
+	std::cout << "----------------" << std::endl;
+}
+
+// Images (given directly or found in the cache) are loaded instead of parsing
+static Program loadProgram(Args &args, Parser &parser, uint64_t sourceHash, bool &isCached)
+{
+	if (args.File && Image::isImage(args.Source))
+	{
+		if (auto imageOpt = Image::open(std::move(args.File.value())))
+		{
+			isCached = true;
+			return Program(std::move(imageOpt.value()));
+		}
+
+		std::cerr << "Image was written by another build of cfmc or is corrupted... "
+			"Please compile it again." << std::endl;
+		std::exit(1);
+	}
+
+	if (args.CacheDir)
+	{
+		if (auto imageOpt = Image::open(Image::getCachePath(args.CacheDir.value(), sourceHash), sourceHash))
+		{
+			isCached = true;
+			return Program(std::move(imageOpt.value()));
+		}
+	}
+
+	return parser.parseProgram(args.Source);
+}
+
 int main(int argc, char **argv)
 {
 	auto args = parseArgs(argc, argv);
 
+	if (args.Lex)
+	{
+		lexSource(args.Source);
+		return 0;
+	}
+
 	Parser parser;
+	parser.setFusion(args.Fusion);
+	parser.setSharing(args.ShareTerms);
+	parser.setThreads(args.Threads);
+	// The source of lazily parsed programs could be rewritten while they're watched
+	parser.setLazy(args.Lazy && !args.Watch);
+
+	if (args.Parse)
+	{
+		parseSource(parser, args.Source, args.Threads);
+		return 0;
+	}
+
+	// Only needed to key images
+	uint64_t sourceHash = (args.Compile || args.CacheDir) ? Image::hashSource(args.Source, args.Fusion) : 0;
+
+	if (args.Compile)
+	{
+		parser.setLazy(false);
+
+		Program program = parser.parseProgram(args.Source);
+		if (!program.compile(args.Compile.value(), sourceHash))
+		{
+			std::cerr << "Image '" << args.Compile.value() << "' could not be written." << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	bool isCached = false;
+	Program program = loadProgram(args, parser, sourceHash, isCached);
+
+	// Stale or corrupted images are simply replaced
+	if (args.CacheDir && !isCached)
+	{
+		program.compile(Image::getCachePath(args.CacheDir.value(), sourceHash), sourceHash);
+	}
+
+	ModuleLinker linker(args.Fusion, args.CacheDir);
+	linker.link(program, args.Dir);
+
+	std::optional<Reloader> reloader;
+	if (args.Watch)
+	{
+		reloader.emplace(program, args.Path, args.Source, args.Fusion);
+	}
+
+	OutputSink &output = OutputSink::getStdout();
+	if (args.Flush)
+	{
+		output.setFlushPolicy(args.Flush.value());
+	}
+	output.setAsync(args.AsyncOutput);
+
+	std::optional<InputSource> input;
+	if (args.Input)
+	{
+		input.emplace(std::move(args.Input.value()));
+	}
+
+	// Each input is run on its own machine
+	if (args.BatchDir)
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		BatchRunner runner(program, args.Jobs);
+		runner.setLoops(args.Loops);
+		runner.setBinaryIo(args.BinaryIo);
+
+		bool isOk = runner.run(args.BatchDir.value(), output);
+
+		std::cerr << runner.getStatsDebug() << std::endl;
+		return isOk ? 0 : 1;
+	}
+
 	Machine machine;
-	machine.execute(parser.parseProgram(args.Source));
+	machine.setProfiling(args.Profile);
+	machine.setLoops(args.Loops);
+	machine.setReloader(reloader ? &reloader.value() : nullptr);
+	if (input)
+	{
+		machine.setInput(input.value());
+	}
+
+	// Frames are streamed between machines as they are
+	if (args.BinaryIo)
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		machine.addDevice("in", std::make_unique<BinaryInputDevice>());
+		machine.addDevice("out", std::make_unique<BinaryOutputDevice>());
+	}
+
+	// Stacks are loaded before 'main' runs & dumped after it finishes
+	std::unordered_map<std::string, MappedStack *> stacks;
+	auto getStack = [&](const std::string &name) -> MappedStack & {
+		auto itStack = stacks.find(name);
+		if (itStack != stacks.end())
+		{
+			return *itStack->second;
+		}
+
+		if (isReservedLoc(internSymbol(name)))
+		{
+			std::cerr << "Location '" << name << "' is reserved, so can't be loaded or dumped." << std::endl;
+			std::exit(1);
+		}
+
+		auto stack = std::make_unique<MappedStack>();
+		MappedStack &ref = *stack;
+		machine.addDevice(name, std::move(stack));
+		return *stacks.emplace(name, &ref).first->second;
+	};
+
+	for (const auto &[name, path] : args.Loads)
+	{
+		if (!getStack(name).load(path))
+		{
+			std::cerr << "File '" << path << "' could not be loaded into location '" << name << "'... "
+				"Please provide a readable file of primitives." << std::endl;
+			return 1;
+		}
+	}
+	for (const auto &[name, path] : args.Dumps)
+	{
+		getStack(name);
+	}
+
+	machine.execute(program);
+
+	for (const auto &[name, path] : args.Dumps)
+	{
+		if (!stacks[name]->dump(path))
+		{
+			std::cerr << "Location '" << name << "' could not be dumped to '" << path << "'... "
+				"Its stack must only hold primitives." << std::endl;
+			return 1;
+		}
+	}
 	
 	if (args.Debug)
 	{
@@ -160,4 +558,18 @@ int main(int argc, char **argv)
 		std::cout << machine.getStackDebug();
 		std::cout << std::endl;
 	}
+
+	if (args.Profile)
+	{
+		std::cout << std::endl;
+		std::cout << machine.getProfileDebug();
+		std::cout << std::endl;
+	}
+
+	if (args.ShareTerms || args.Lazy)
+	{
+		std::cout << std::endl;
+		std::cout << program.getTermsDebug();
+		std::cout << std::endl;
+	}
 }
\ No newline at end of file
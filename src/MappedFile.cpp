@@ -0,0 +1,148 @@
+#include "MappedFile.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::optional<MappedFile> MappedFile::open(const std::string &path)
+{
+	MappedFile file;
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return std::nullopt;
+	}
+
+	file.m_File = handle;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size))
+	{
+		return std::nullopt;
+	}
+
+	file.m_Size = static_cast<size_t>(size.QuadPart);
+
+	// Empty files can't be mapped (and don't need to be)
+	if (file.m_Size > 0)
+	{
+		file.m_Mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!file.m_Mapping)
+		{
+			return std::nullopt;
+		}
+
+		file.m_Data = static_cast<const char *>(MapViewOfFile(file.m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!file.m_Data)
+		{
+			return std::nullopt;
+		}
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return std::nullopt;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		::close(fd);
+		return std::nullopt;
+	}
+
+	file.m_Size = static_cast<size_t>(st.st_size);
+
+	// Empty files can't be mapped (and don't need to be)
+	if (file.m_Size > 0)
+	{
+		void *data = mmap(nullptr, file.m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			::close(fd);
+			return std::nullopt;
+		}
+
+		// The file is read front to back
+		madvise(data, file.m_Size, MADV_SEQUENTIAL);
+		file.m_Data = static_cast<const char *>(data);
+	}
+
+	// The mapping keeps its own reference to the file
+	::close(fd);
+#endif
+
+	return file;
+}
+
+MappedFile::MappedFile(MappedFile &&file)
+	: m_Data(file.m_Data)
+	, m_Size(file.m_Size)
+#ifdef _WIN32
+	, m_File(file.m_File)
+	, m_Mapping(file.m_Mapping)
+#endif
+{
+	file.m_Data = nullptr;
+	file.m_Size = 0;
+
+#ifdef _WIN32
+	file.m_File = nullptr;
+	file.m_Mapping = nullptr;
+#endif
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&file)
+{
+	// The destructor of 'file' releases what was held before
+	std::swap(m_Data, file.m_Data);
+	std::swap(m_Size, file.m_Size);
+
+#ifdef _WIN32
+	std::swap(m_File, file.m_File);
+	std::swap(m_Mapping, file.m_Mapping);
+#endif
+
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (m_Data)
+	{
+		UnmapViewOfFile(m_Data);
+	}
+	if (m_Mapping)
+	{
+		CloseHandle(m_Mapping);
+	}
+	if (m_File)
+	{
+		CloseHandle(m_File);
+	}
+#else
+	if (m_Data)
+	{
+		munmap(const_cast<char *>(m_Data), m_Size);
+	}
+#endif
+}
+
+std::string_view MappedFile::getView() const
+{
+	return std::string_view(m_Data ? m_Data : "", m_Size);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+
+// Read-only view of the contents of a file, which is memory-mapped rather than
+// read into a buffer. The view stays valid (even when moved) until destroyed.
+class MappedFile
+{
+public:
+	static std::optional<MappedFile> open(const std::string &path);
+
+	MappedFile(const MappedFile &file) = delete;
+	MappedFile(MappedFile &&file);
+	~MappedFile();
+
+	MappedFile &operator=(const MappedFile &file) = delete;
+	MappedFile &operator=(MappedFile &&file);
+
+	std::string_view getView() const;
+
+private:
+	MappedFile() = default;
+
+private:
+	const char *m_Data = nullptr;
+	size_t m_Size = 0;
+
+#ifdef _WIN32
+	void *m_File = nullptr;
+	void *m_Mapping = nullptr;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "MappedStack.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <charconv>
+#include <cctype>
+
+// Primitive a pushed value is (or is a variable bound to)
+static std::optional<Prim_t> getPrim(const Env_t &env, TermHandle_t term)
+{
+	if (term->isVar() && (!term->getBody() || term->getBody()->isNil()))
+	{
+		auto itEnv = env.first.find(term->asVar().getVar());
+		if (itEnv != env.first.end())
+		{
+			term = reinterpret_cast<const Closure_t *>(itEnv->second.get())->second;
+		}
+	}
+
+	if (term->isVal() && term->asVal().isPrim())
+	{
+		return term->asVal().asPrim();
+	}
+	return std::nullopt;
+}
+
+bool MappedStack::load(const std::string &path)
+{
+	m_File = MappedFile::open(path);
+	if (!m_File)
+	{
+		return false;
+	}
+
+	std::string_view view = m_File->getView();
+
+	if (isText(path))
+	{
+		const char *it = view.data();
+		const char *end = view.data() + view.size();
+
+		while (true)
+		{
+			while (it != end && std::isspace(static_cast<unsigned char>(*it)))
+			{
+				++it;
+			}
+			if (it == end)
+			{
+				break;
+			}
+
+			Prim_t prim;
+			auto [ptr, ec] = std::from_chars(it, end, prim);
+			if (ec != std::errc() || (ptr != end && !std::isspace(static_cast<unsigned char>(*ptr))))
+			{
+				return false;
+			}
+
+			m_Parsed.push_back(prim);
+			it = ptr;
+		}
+
+		m_Prims = m_Parsed.data();
+		m_NumPrims = m_Parsed.size();
+	}
+	else
+	{
+		if (view.size() % sizeof(Prim_t) != 0)
+		{
+			return false;
+		}
+
+		// Mappings are page aligned
+		m_Prims = reinterpret_cast<const Prim_t *>(view.data());
+		m_NumPrims = view.size() / sizeof(Prim_t);
+	}
+
+	m_Next = 0;
+	return true;
+}
+
+bool MappedStack::dump(const std::string &path) const
+{
+	// Top of the stack first
+	std::vector<Prim_t> prims;
+	prims.reserve(m_Pushed.size() + (m_NumPrims - m_Next));
+
+	for (auto it = m_Pushed.rbegin(); it != m_Pushed.rend(); ++it)
+	{
+		if (auto primOpt = getPrim(it->first, it->second))
+		{
+			prims.push_back(primOpt.value());
+		}
+		else
+		{
+			return false;
+		}
+	}
+	prims.insert(prims.end(), m_Prims + m_Next, m_Prims + m_NumPrims);
+
+	// Written beside the file & then renamed, as it may be the one loaded from
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+
+		if (isText(path))
+		{
+			std::string buffer;
+			for (Prim_t prim : prims)
+			{
+				char chars[16];
+				auto [end, ec] = std::to_chars(chars, chars + sizeof(chars), prim);
+
+				buffer.append(chars, end);
+				buffer += '\n';
+			}
+			file.write(buffer.data(), buffer.size());
+		}
+		else
+		{
+			file.write(reinterpret_cast<const char *>(prims.data()), prims.size() * sizeof(Prim_t));
+		}
+
+		if (!file)
+		{
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	return !error;
+}
+
+bool MappedStack::push(Machine &machine, const Env_t &env, TermHandle_t term)
+{
+	// Primitives are pushed without the environment they were bound in
+	if (auto primOpt = getPrim(env, term))
+	{
+		m_Pushed.push_back(std::make_pair(Env_t{}, machine.freshTerm(ValTerm(primOpt.value()))));
+	}
+	else
+	{
+		m_Pushed.push_back(std::make_pair(env, term));
+	}
+	return true;
+}
+
+bool MappedStack::pushLoc(Machine &machine, Loc_t loc)
+{
+	m_Pushed.push_back(std::make_pair(Env_t{}, machine.freshTerm(ValTerm(loc))));
+	return true;
+}
+
+std::optional<Closure_t> MappedStack::pop(Machine &machine)
+{
+	if (!m_Pushed.empty())
+	{
+		Closure_t closure = std::move(m_Pushed.back());
+		m_Pushed.pop_back();
+		return closure;
+	}
+	else if (m_Next < m_NumPrims)
+	{
+		return std::make_pair(Env_t{}, machine.freshTerm(ValTerm(m_Prims[m_Next++])));
+	}
+	return std::nullopt;
+}
+
+std::optional<Loc_t> MappedStack::popLoc(Machine &)
+{
+	// Only pushed values can be locations
+	if (!m_Pushed.empty() && m_Pushed.back().second->isVal())
+	{
+		const ValTerm &val = m_Pushed.back().second->asVal();
+		m_Pushed.pop_back();
+
+		if (val.isLoc())
+		{
+			return val.asLoc();
+		}
+	}
+	return std::nullopt;
+}
+
+bool MappedStack::isText(const std::string &path)
+{
+	return std::filesystem::path(path).extension() == ".txt";
+}
\ No newline at end of file
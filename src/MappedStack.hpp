@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+
+#include "Device.hpp"
+#include "MappedFile.hpp"
+
+// Location whose stack is loaded from (and dumped to) a file of primitives,
+// for '--load loc=path' & '--dump loc=path'. The first primitive in the file
+// is the top of the stack.
+//
+// Files ending in '.txt' hold primitives as whitespace separated decimals,
+// any other file holds them as an array of 32-bit integers (in the native byte
+// order). The primitives of binary files are popped straight from the mapping,
+// so loading one doesn't allocate anything per primitive. Values pushed on top
+// of them are kept as closures, like any other stack.
+class MappedStack : public Device
+{
+public:
+	// False if the file can't be read or isn't a file of primitives
+	bool load(const std::string &path);
+
+	// False if the file can't be written or the stack holds anything other
+	// than primitives
+	bool dump(const std::string &path) const;
+
+	bool push(Machine &machine, const Env_t &env, TermHandle_t term) override;
+	bool pushLoc(Machine &machine, Loc_t loc) override;
+
+	std::optional<Closure_t> pop(Machine &machine) override;
+	std::optional<Loc_t> popLoc(Machine &machine) override;
+
+private:
+	static bool isText(const std::string &path);
+
+private:
+	std::optional<MappedFile> m_File;
+	// Primitives parsed from a text file
+	std::vector<Prim_t> m_Parsed;
+
+	// Primitives not yet popped are 'm_Prims[m_Next..m_NumPrims)'
+	const Prim_t *m_Prims = nullptr;
+	size_t m_NumPrims = 0;
+	size_t m_Next = 0;
+
+	// Values pushed on top of the primitives
+	ClosureStack_t m_Pushed;
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "Module.hpp"
+
+#include <iostream>
+#include <filesystem>
+#include <cstdlib>
+
+#include "Parser.hpp"
+#include "MappedFile.hpp"
+#include "Image.hpp"
+
+static void importError(const std::string &message)
+{
+	std::cerr << "[Import Error] " << message << std::endl;
+	std::exit(1);
+}
+
+// 'a::b' is the file 'a/b.fmc'
+static std::filesystem::path getModulePath(const std::string &dir, const std::string &moduleName)
+{
+	std::string path = moduleName;
+	for (size_t pos = path.find("::"); pos != std::string::npos; pos = path.find("::", pos))
+	{
+		path.replace(pos, 2, "/");
+	}
+
+	return std::filesystem::path(dir) / (path + ".fmc");
+}
+
+ModuleLinker::ModuleLinker(bool isFusionEnabled, std::optional<std::string> cacheDir)
+	: m_IsFusionEnabled(isFusionEnabled)
+	, m_CacheDir(std::move(cacheDir))
+{}
+
+void ModuleLinker::link(Program &program, const std::string &dir)
+{
+	// Copied, as linking adds to the program
+	Program::Imports_t imports = program.getImports();
+
+	for (Symbol_t import : imports)
+	{
+		linkModule(program, import, dir);
+	}
+}
+
+void ModuleLinker::linkModule(Program &program, Symbol_t moduleName, const std::string &dir)
+{
+	if (!m_Linked.insert(moduleName).second)
+	{
+		return;
+	}
+
+	const std::string &name = getSymbolName(moduleName);
+	std::filesystem::path path = getModulePath(dir, name);
+	std::string moduleDir = path.parent_path().string();
+
+	auto fileOpt = MappedFile::open(path.string());
+	if (!fileOpt)
+	{
+		importError("Module '" + name + "' could not be read from '" + path.string() + "'.");
+	}
+
+	std::string_view source = fileOpt->getView();
+	Program::Imports_t imports;
+
+	bool isCached = false;
+
+	uint64_t sourceHash = m_CacheDir ? Image::hashSource(source, m_IsFusionEnabled, name) : 0;
+	std::string cachePath = m_CacheDir ? Image::getCachePath(m_CacheDir.value(), sourceHash) : "";
+
+	if (m_CacheDir)
+	{
+		if (auto imageOpt = Image::open(cachePath, sourceHash))
+		{
+			imports = imageOpt->getImports();
+			program.link(std::move(imageOpt.value()));
+			isCached = true;
+		}
+	}
+
+	if (!isCached)
+	{
+		TermArena arena;
+
+		Parser parser;
+		parser.setFusion(m_IsFusionEnabled);
+		Program::FuncDefs_t funcs = parser.parseModule(source, name, arena, imports);
+
+		// Stale or corrupted images are simply replaced
+		if (m_CacheDir)
+		{
+			Image::write(cachePath, sourceHash, arena.get(k_NilTermIdx), arena.size(), funcs, imports);
+		}
+
+		program.link(std::move(arena), funcs);
+	}
+
+	for (Symbol_t import : imports)
+	{
+		linkModule(program, import, moduleDir);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <unordered_set>
+
+#include "Config.hpp"
+#include "Program.hpp"
+
+// Links the modules imported by a program (and those they import, each only
+// once) into it. Module 'name' is the file 'name.fmc' (or 'a/b.fmc' for
+// 'a::b') in the directory of whichever program or module imports it.
+//
+// Each module is parsed on its own, so when a cache directory is given it's
+// kept as an image (see 'Image') which is only rebuilt when it changes.
+class ModuleLinker
+{
+public:
+	ModuleLinker(bool isFusionEnabled, std::optional<std::string> cacheDir);
+
+	// 'dir' is the directory of the program
+	void link(Program &program, const std::string &dir);
+
+private:
+	void linkModule(Program &program, Symbol_t moduleName, const std::string &dir);
+
+private:
+	bool m_IsFusionEnabled;
+	std::optional<std::string> m_CacheDir;
+	std::unordered_set<Symbol_t> m_Linked;
+};
\ No newline at end of file
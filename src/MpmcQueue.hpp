@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Bounded queue which any number of threads push to & pop from without locks.
+// Each cell has a sequence number saying whether it's ready to be written (for
+// the lap of the ring it's in) or read, so a push or pop only has to claim its
+// position with one compare & swap. Neither blocks, they fail when the queue
+// is full (or empty), see 'Channel' for waiting.
+template <typename T>
+class MpmcQueue
+{
+public:
+	// The capacity is rounded up to a power of two
+	explicit MpmcQueue(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size *= 2;
+		}
+
+		m_Cells = std::make_unique<Cell[]>(size);
+		m_Mask = size - 1;
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_Cells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpmcQueue(const MpmcQueue &queue) = delete;
+	MpmcQueue &operator=(const MpmcQueue &queue) = delete;
+
+	size_t getCapacity() const
+	{
+		return m_Mask + 1;
+	}
+
+	// Number of values, which is only a hint while other threads are pushing
+	// or popping (a value being pushed is counted before it can be popped)
+	size_t getSizeHint() const
+	{
+		size_t head = m_Head.load(std::memory_order_relaxed);
+		size_t tail = m_Tail.load(std::memory_order_relaxed);
+		return (tail > head) ? tail - head : 0;
+	}
+
+	bool tryPush(const T &value)
+	{
+		size_t pos = m_Tail.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		while (true)
+		{
+			cell = &m_Cells[pos & m_Mask];
+			size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+			if (diff == 0)
+			{
+				if (m_Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			// Still holding the value of the last lap, so full
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_Tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->Value = value;
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T &value)
+	{
+		size_t pos = m_Head.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		while (true)
+		{
+			cell = &m_Cells[pos & m_Mask];
+			size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+			if (diff == 0)
+			{
+				if (m_Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			// Not written yet, so empty
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_Head.load(std::memory_order_relaxed);
+			}
+		}
+
+		value = cell->Value;
+		// Ready to be written on the next lap
+		cell->Sequence.store(pos + m_Mask + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Value;
+	};
+
+	std::unique_ptr<Cell[]> m_Cells;
+	size_t m_Mask = 0;
+
+	// On their own cache lines, as they're written by different threads
+	alignas(64) std::atomic<size_t> m_Head = 0;
+	alignas(64) std::atomic<size_t> m_Tail = 0;
+};
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "Output.hpp"
+
+#include <charconv>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+OutputSink::OutputSink(std::FILE *file)
+	: m_File(file)
+	, m_FlushPolicy(isatty(fileno(file)) ? FlushPolicy::Line : FlushPolicy::Size)
+{
+	m_Buffer.reserve(m_FlushSize);
+}
+
+OutputSink::OutputSink(std::string &str)
+	: m_String(&str)
+	, m_FlushPolicy(FlushPolicy::Size)
+{
+	m_Buffer.reserve(m_FlushSize);
+}
+
+OutputSink::~OutputSink()
+{
+	setAsync(false);
+	flush();
+}
+
+void OutputSink::setFlushPolicy(FlushPolicy policy)
+{
+	m_FlushPolicy = policy;
+}
+
+void OutputSink::setFlushSize(size_t size)
+{
+	m_FlushSize = std::max<size_t>(size, 1);
+	m_Buffer.reserve(m_FlushSize);
+}
+
+void OutputSink::setFlushInterval(std::chrono::milliseconds interval)
+{
+	m_FlushInterval = interval;
+}
+
+void OutputSink::setAsync(bool isEnabled)
+{
+	if (isEnabled == m_IsAsync)
+	{
+		return;
+	}
+
+	if (isEnabled)
+	{
+		m_IsStopping = false;
+		m_IsAsync = true;
+		m_Writer = std::thread(&OutputSink::runWriter, this);
+	}
+	else
+	{
+		// The writer finishes what's pending before stopping
+		{
+			std::lock_guard lock(m_Mutex);
+			m_IsStopping = true;
+		}
+		m_PendingCond.notify_one();
+
+		m_Writer.join();
+		m_IsAsync = false;
+	}
+}
+
+void OutputSink::writePrim(Prim_t prim)
+{
+	bool wasEmpty = m_Buffer.empty();
+
+	char chars[16];
+	auto [end, ec] = std::to_chars(chars, chars + sizeof(chars), prim);
+
+	m_Buffer.append(chars, end);
+	m_Buffer += '\n';
+	onWrite(wasEmpty);
+}
+
+void OutputSink::writeLine(std::string_view line)
+{
+	bool wasEmpty = m_Buffer.empty();
+
+	m_Buffer += line;
+	m_Buffer += '\n';
+	onWrite(wasEmpty);
+}
+
+void OutputSink::write(std::string_view bytes)
+{
+	if (bytes.empty())
+	{
+		return;
+	}
+
+	bool wasEmpty = m_Buffer.empty();
+
+	m_Buffer += bytes;
+	onWrite(wasEmpty);
+}
+
+void OutputSink::writeFrame(FrameTag tag, std::string_view payload)
+{
+	bool wasEmpty = m_Buffer.empty();
+
+	char header[k_FrameHeaderSize];
+	header[0] = static_cast<char>(tag);
+
+	uint32_t size = static_cast<uint32_t>(payload.size());
+	std::memcpy(header + 1, &size, sizeof(size));
+
+	m_Buffer.append(header, sizeof(header));
+	m_Buffer += payload;
+	onWrite(wasEmpty);
+}
+
+void OutputSink::flush()
+{
+	submit();
+
+	if (m_IsAsync)
+	{
+		std::unique_lock lock(m_Mutex);
+		m_WrittenCond.wait(lock, [this]() { return m_Pending.empty() && !m_IsWriting; });
+	}
+
+	if (m_File)
+	{
+		std::fflush(m_File);
+	}
+}
+
+void OutputSink::poll(bool isBlocking)
+{
+	if (m_FlushPolicy != FlushPolicy::Time || m_Buffer.empty())
+	{
+		return;
+	}
+
+	if (isBlocking || std::chrono::steady_clock::now() - m_FirstWriteTime >= m_FlushInterval)
+	{
+		submit();
+	}
+}
+
+OutputSink &OutputSink::getStdout()
+{
+	static OutputSink sink(stdout);
+	return sink;
+}
+
+void OutputSink::onWrite(bool wasEmpty)
+{
+	switch (m_FlushPolicy)
+	{
+	case FlushPolicy::Line:
+		flush();
+		break;
+	case FlushPolicy::Size:
+		if (m_Buffer.size() >= m_FlushSize)
+		{
+			submit();
+		}
+		break;
+	case FlushPolicy::Time:
+	{
+		auto now = std::chrono::steady_clock::now();
+
+		// This value is the oldest unwritten one
+		if (wasEmpty)
+		{
+			m_FirstWriteTime = now;
+		}
+
+		if (m_Buffer.size() >= m_FlushSize || now - m_FirstWriteTime >= m_FlushInterval)
+		{
+			submit();
+		}
+		break;
+	}
+	case FlushPolicy::Exit:
+		break;
+	}
+}
+
+void OutputSink::submit()
+{
+	if (m_Buffer.empty())
+	{
+		return;
+	}
+
+	if (!m_IsAsync)
+	{
+		writeFile(m_Buffer);
+		m_Buffer.clear();
+		return;
+	}
+
+	{
+		std::unique_lock lock(m_Mutex);
+
+		// Too far behind the consumer, so wait for it to catch up
+		m_WrittenCond.wait(lock, [this]() { return m_Pending.size() < s_MaxPending; });
+
+		m_Pending.push_back(std::move(m_Buffer));
+	}
+	m_PendingCond.notify_one();
+
+	m_Buffer = std::string();
+	m_Buffer.reserve(m_FlushSize);
+}
+
+void OutputSink::writeFile(const std::string &buffer)
+{
+	if (m_String)
+	{
+		m_String->append(buffer);
+		return;
+	}
+
+	std::fwrite(buffer.data(), 1, buffer.size(), m_File);
+	std::fflush(m_File);
+}
+
+void OutputSink::runWriter()
+{
+	std::unique_lock lock(m_Mutex);
+
+	while (true)
+	{
+		m_PendingCond.wait(lock, [this]() { return !m_Pending.empty() || m_IsStopping; });
+
+		if (m_Pending.empty())
+		{
+			return;
+		}
+
+		std::string buffer = std::move(m_Pending.front());
+		m_Pending.pop_front();
+		m_IsWriting = true;
+
+		lock.unlock();
+		writeFile(buffer);
+		lock.lock();
+
+		m_IsWriting = false;
+		m_WrittenCond.notify_all();
+	}
+}
\ No newline at end of file
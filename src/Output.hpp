@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+
+#include "Config.hpp"
+#include "Frame.hpp"
+
+// Buffered writer for the 'out' location, each value being written as a line.
+// Values are formatted into a buffer which is only written to the file when
+// the flush policy says so (or when explicitly flushed, or destroyed).
+class OutputSink
+{
+public:
+	enum class FlushPolicy
+	{
+		Line, // After every value
+		Size, // When the buffer reaches the flush size
+		Time, // As 'Size', or when the oldest unwritten value is older than the flush interval
+		Exit  // Only when flushed (or destroyed), the buffer grows as needed
+	};
+
+public:
+	// Terminals are flushed on every line, anything else by size
+	explicit OutputSink(std::FILE *file = stdout);
+	// Output is appended to the string when flushed (for embedding)
+	explicit OutputSink(std::string &str);
+	~OutputSink();
+
+	OutputSink(const OutputSink &sink) = delete;
+	OutputSink &operator=(const OutputSink &sink) = delete;
+
+	void setFlushPolicy(FlushPolicy policy);
+	void setFlushSize(size_t size);
+	void setFlushInterval(std::chrono::milliseconds interval);
+
+	// Full buffers are written by a background thread, so a slow consumer
+	// doesn't block the machine (until 's_MaxPending' buffers are waiting)
+	void setAsync(bool isEnabled);
+
+	// Formats the primitive without going through a stream
+	void writePrim(Prim_t prim);
+	void writeLine(std::string_view line);
+	// Writes the bytes as they are (e.g. the output of another sink)
+	void write(std::string_view bytes);
+
+	// Writes a frame of the binary wire format (see 'Frame.hpp')
+	void writeFrame(FrameTag tag, std::string_view payload);
+
+	// Blocks until everything written so far has reached the file
+	void flush();
+	// Submits values which are past the flush interval ('Time' policy), as
+	// writes are the only other place it's checked. When about to block, all
+	// of them are submitted (as the wait could last any time)
+	void poll(bool isBlocking = false);
+
+	// Sink for stdout shared by machines which weren't given one
+	static OutputSink &getStdout();
+
+private:
+	void onWrite(bool wasEmpty);
+	void submit();
+	void writeFile(const std::string &buffer);
+	void runWriter();
+
+private:
+	std::FILE *m_File = nullptr;
+	std::string *m_String = nullptr;
+	std::string m_Buffer;
+
+	FlushPolicy m_FlushPolicy;
+	size_t m_FlushSize = 64 * 1024;
+	std::chrono::milliseconds m_FlushInterval = std::chrono::milliseconds(100);
+	std::chrono::steady_clock::time_point m_FirstWriteTime;
+
+	// Background writer, only running when asynchronous
+	bool m_IsAsync = false;
+	bool m_IsStopping = false;
+	bool m_IsWriting = false;
+	std::deque<std::string> m_Pending;
+	std::mutex m_Mutex;
+	std::condition_variable m_PendingCond;
+	std::condition_variable m_WrittenCond;
+	std::thread m_Writer;
+
+	static const size_t s_MaxPending = 64;
+};
\ No newline at end of file
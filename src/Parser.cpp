@@ -4,22 +4,35 @@
 #include <iomanip>
 #include <sstream>
 #include <cstdlib>
+#include <algorithm>
+#include <charconv>
 
 #include "Utils.hpp"
+#include "Fusion.hpp"
+#include "ThreadPool.hpp"
+
+// Parse errors unwind to the top of the parser, so that definitions parsed
+// concurrently can report the first error (in order of the source)
+struct ParseError
+{
+	std::string Report;
+};
 
 static void parseError(std::string message, const Lexer &lexer)
 {
+	std::stringstream report;
+
 	if (auto tokenBufferOpt = lexer.getPeekBuffer())
 	{
-		std::cerr << "[Parse Error]" << std::endl;
+		report << "[Parse Error]" << std::endl;
 
 		auto findSub = [](const std::string& str, const std::string& sub) {
 			std::size_t res = str.rfind(sub, str.size() - sub.size());
 			return (res != std::string::npos) ? std::optional(res) : std::nullopt;
 		};
 
-		const std::string buffer = lexer.getBuffer();
-		std::string tokenBuffer = tokenBufferOpt.value();
+		const std::string buffer(lexer.getBuffer());
+		std::string tokenBuffer(tokenBufferOpt.value());
 		size_t tokenBufferPos = 0;
 		size_t tokenBufferLen = 0;
 		
@@ -27,7 +40,7 @@ static void parseError(std::string message, const Lexer &lexer)
 		std::stringstream ss(buffer);
 		while (std::getline(ss, line))
 		{
-			std::cerr << "| " << line << std::endl;
+			report << "| " << line << std::endl;
 
 			if (auto tokenBufferPosOpt = findSub(line, tokenBuffer))
 			{
@@ -42,7 +55,7 @@ static void parseError(std::string message, const Lexer &lexer)
 		err1 += " ";
 		err1 += message;
 
-		std::cerr << "| " << err1 << std::endl;
+		report << "| " << err1 << std::endl;
 		
 		std::string err2;
 		err2 += std::string(tokenBufferPos, ' ');
@@ -50,625 +63,926 @@ static void parseError(std::string message, const Lexer &lexer)
 		err2 += tokenBuffer;
 		err2 += "'";
 
-		std::cerr << "| " << err2 << std::endl;
+		report << "| " << err2 << std::endl;
 	}
 
+	throw ParseError{report.str()};
+}
+
+static void reportParseError(const ParseError &error)
+{
+	std::cerr << error.Report;
 	std::exit(1);
 }
 
-Parser::Parser() : m_Lexer(nullptr) {}
+// Splits the source after each top-level definition (where the parentheses
+// balance), grouping definitions into (roughly) 'numChunks' chunks
+static std::vector<std::pair<size_t, size_t>> splitFuncDefs(std::string_view source, size_t numChunks)
+{
+	std::vector<std::pair<size_t, size_t>> chunks;
+
+	size_t chunkSize = source.size() / std::max<size_t>(numChunks, 1) + 1;
+	size_t begin = 0;
+	int depth = 0;
+
+	for (size_t i = 0; i < source.size(); ++i)
+	{
+		if (source[i] == '(')
+		{
+			depth++;
+		}
+		else if (source[i] == ')' && --depth <= 0)
+		{
+			depth = 0;
+
+			if (i + 1 - begin >= chunkSize)
+			{
+				chunks.emplace_back(begin, i + 1);
+				begin = i + 1;
+			}
+		}
+	}
+
+	chunks.emplace_back(begin, source.size());
+	return chunks;
+}
+
+static Prim_t parsePrim(std::string_view buffer, const Lexer &lexer)
+{
+	Prim_t prim = 0;
+
+	auto [ptr, ec] = std::from_chars(buffer.data(), buffer.data() + buffer.size(), prim);
+	if (ec != std::errc())
+	{
+		parseError("Primitive is out of range", lexer);
+	}
+
+	return prim;
+}
+
+Parser::Parser() : m_Lexer(nullptr), m_Arena(nullptr), m_IsFusionEnabled(true), m_IsSharingEnabled(false), m_NumThreads(1), m_IsLazyEnabled(false) {}
 
-Program Parser::parseProgram(const std::string &programSrc)
+void Parser::setFusion(bool isEnabled)
 {
-	m_Lexer = std::make_unique<Lexer>(programSrc);
+	m_IsFusionEnabled = isEnabled;
+}
 
-	Program::FuncDefs_t funcs = parseFuncDefs();
-	return Program(std::move(funcs));
+void Parser::setSharing(bool isEnabled)
+{
+	m_IsSharingEnabled = isEnabled;
 }
 
-std::optional<Term> Parser::parseTerm(const std::string &termSrc)
+void Parser::setThreads(size_t numThreads)
 {
-	m_Lexer = std::make_unique<Lexer>(termSrc);
+	m_NumThreads = std::max<size_t>(numThreads, 1);
+}
 
-	if (auto termOpt = parseTerm())
+void Parser::setLazy(bool isEnabled)
+{
+	m_IsLazyEnabled = isEnabled;
+}
+
+Program Parser::parseProgram(std::string_view programSrc)
+{
+	if (m_IsLazyEnabled)
 	{
-		return std::move(termOpt.value());
+		Program::FuncRanges_t funcs;
+		Program::Imports_t imports;
+
+		try
+		{
+			scanFuncDefs(programSrc, funcs, imports);
+		}
+		catch (const ParseError &error)
+		{
+			reportParseError(error);
+		}
+
+		return Program(programSrc, std::move(funcs), std::move(imports), m_IsFusionEnabled);
 	}
 
-	return std::nullopt;
+	TermArena arena;
+	Program::FuncDefs_t funcs;
+	Program::Imports_t imports;
+
+	try
+	{
+		parseProgram(programSrc, arena, funcs, imports);
+	}
+	catch (const ParseError &error)
+	{
+		reportParseError(error);
+	}
+
+	return Program(std::move(arena), std::move(funcs), std::move(imports));
 }
 
-Program::FuncDefs_t Parser::parseFuncDefs()
+std::optional<std::string> Parser::tryParseProgram(std::string_view programSrc, std::optional<Program> &program)
 {
+	TermArena arena;
 	Program::FuncDefs_t funcs;
-	
-	while (!m_Lexer->isPeekToken(Token::Eof))
+	Program::Imports_t imports;
+
+	try
 	{
-		if (m_Lexer->isPeekToken(Token::Id))
-		{
-			if (auto funcOpt = m_Lexer->getPeekBuffer())
-			{
-				m_Lexer->next();
+		parseProgram(programSrc, arena, funcs, imports);
+	}
+	catch (const ParseError &error)
+	{
+		m_Arena = nullptr;
+		return error.Report;
+	}
 
-				if (m_Lexer->isPeekToken(Token::Equal))
-				{
-					m_Lexer->next();
+	program.emplace(std::move(arena), std::move(funcs), std::move(imports));
+	return std::nullopt;
+}
 
-					if (m_Lexer->isPeekToken(Token::Lb))
-					{
-						m_Lexer->next();
+void Parser::parseProgram(std::string_view programSrc, TermArena &arena, Program::FuncDefs_t &funcs,
+	Program::Imports_t &imports)
+{
+	arena.setSharing(m_IsSharingEnabled);
 
-						if (auto termOpt = parseTerm())
-						{
-							if (m_Lexer->isPeekToken(Token::Rb))
-							{
-								m_Lexer->next();
-								funcs[funcOpt.value()] = newTerm(std::move(termOpt.value()));
-							}
-							else
-							{
-								parseError("Expected ')' after definition of function '" + funcOpt.value() + "'", *m_Lexer);
-							}
-						}
-						else
-						{
-							parseError("Expected term for definition of function '" + funcOpt.value() + "'", *m_Lexer);
-						}
-					}
-					else
-					{
-						parseError("Expected '(' before definition of function '" + funcOpt.value() + "'", *m_Lexer);
-					}
+	// Terms are only shared within an arena, so sharing is always serial
+	if (m_NumThreads <= 1 || m_IsSharingEnabled || programSrc.size() < s_MinParallelSize)
+	{
+		parseFuncDefs(programSrc, 0, programSrc.size(), arena, funcs, imports);
+		return;
+	}
+
+	struct Chunk
+	{
+		size_t Begin = 0;
+		size_t End = 0;
+
+		TermArena Arena;
+		Program::FuncDefs_t Funcs;
+		Program::Imports_t Imports;
+		std::optional<ParseError> Error;
+	};
+
+	auto bounds = splitFuncDefs(programSrc, m_NumThreads * 4);
+	std::vector<Chunk> chunks(bounds.size());
+
+	{
+		ThreadPool pool(std::min(m_NumThreads, chunks.size()));
+
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			Chunk &chunk = chunks[i];
+			chunk.Begin = bounds[i].first;
+			chunk.End = bounds[i].second;
+
+			pool.push([&, this]() {
+				Parser parser;
+				parser.setFusion(m_IsFusionEnabled);
+
+				try
+				{
+					parser.parseFuncDefs(programSrc, chunk.Begin, chunk.End, chunk.Arena, chunk.Funcs, chunk.Imports);
 				}
-				else
+				catch (const ParseError &error)
 				{
-					parseError("Expected '=' after declaration of function '" + funcOpt.value() + "'", *m_Lexer);
+					chunk.Error = error;
 				}
-			}
+			});
 		}
-		else
+
+		pool.wait();
+	}
+
+	// Chunks are merged in order, so later definitions replace earlier ones
+	for (Chunk &chunk : chunks)
+	{
+		if (chunk.Error)
 		{
-			parseError("Expected function declaration", *m_Lexer);
+			throw chunk.Error.value();
 		}
+
+		TermIdx_t offset = arena.append(std::move(chunk.Arena));
+
+		for (auto itFuncs = chunk.Funcs.begin(); itFuncs != chunk.Funcs.end(); ++itFuncs)
+		{
+			funcs[itFuncs->first] = itFuncs->second + offset;
+		}
+
+		imports.insert(imports.end(), chunk.Imports.begin(), chunk.Imports.end());
 	}
 
-	return funcs;
 }
 
-std::optional<Term> Parser::parseTerm()
+std::optional<TermHandle_t> Parser::parseTerm(std::string_view termSrc, TermArena &arena)
 {
-	if (m_Lexer->isPeekToken(Token::Asterisk))
+	std::optional<TermHandle_t> termOpt;
+
+	if (auto errorOpt = tryParseTerm(termSrc, arena, termOpt))
 	{
-		m_Lexer->next();
-		return Term(NilTerm());
+		reportParseError(ParseError{errorOpt.value()});
 	}
-	else if (auto varOpt = parseVar())
+
+	return termOpt;
+}
+
+std::optional<std::string> Parser::tryParseTerm(std::string_view termSrc, TermArena &arena,
+	std::optional<TermHandle_t> &term)
+{
+	m_Lexer = std::make_unique<Lexer>(termSrc);
+	m_Arena = &arena;
+
+	std::optional<TermIdx_t> termOpt;
+
+	try
 	{
-		return Term(std::move(varOpt.value()));
+		termOpt = parseTerm();
 	}
-	else if(auto locAbsOpt = parseLocAbs())
+	catch (const ParseError &error)
+	{
+		m_Arena = nullptr;
+		return error.Report;
+	}
+
+	m_Arena = nullptr;
+
+	if (termOpt)
 	{
-		return Term(std::move(locAbsOpt.value()));
+		term = arena.get(termOpt.value());
 	}
-	else if (auto locAppOpt = parseLocApp())
+
+	return std::nullopt;
+}
+
+Program::FuncDefs_t Parser::parseFuncDefs(std::string_view source, size_t begin, size_t end, TermArena &arena)
+{
+	Program::FuncDefs_t funcs;
+	Program::Imports_t imports;
+
+	try
 	{
-		return Term(std::move(locAppOpt.value()));
+		parseFuncDefs(source, begin, end, arena, funcs, imports);
 	}
-	else if (auto absOpt = parseAbs())
+	catch (const ParseError &error)
 	{
-		return Term(std::move(absOpt.value()));
+		reportParseError(error);
 	}
-	else if (auto appOpt = parseApp())
+
+	return funcs;
+}
+
+Program::FuncDefs_t Parser::parseModule(std::string_view source, std::string_view moduleName,
+	TermArena &arena, Program::Imports_t &imports)
+{
+	Program::FuncDefs_t funcs;
+
+	try
 	{
-		return Term(std::move(appOpt.value()));
+		// The names of all the definitions are needed before any are parsed
+		Program::FuncRanges_t ranges;
+		Program::Imports_t scannedImports;
+		scanFuncDefs(source, ranges, scannedImports);
+
+		m_ModuleName = moduleName;
+		for (auto itRanges = ranges.begin(); itRanges != ranges.end(); ++itRanges)
+		{
+			m_ModuleFuncs.insert(itRanges->first);
+		}
+
+		parseFuncDefs(source, 0, source.size(), arena, funcs, imports);
 	}
-	else if (auto valOpt = parseVal())
+	catch (const ParseError &error)
 	{
-		return Term(std::move(valOpt.value()));
+		reportParseError(error);
 	}
-	else if (auto binOpOpt = parseBinOp())
+
+	m_ModuleName.clear();
+	m_ModuleFuncs.clear();
+
+	return funcs;
+}
+
+std::optional<std::string> Parser::tryScanFuncDefs(std::string_view source, Program::FuncRanges_t &funcs)
+{
+	Program::Imports_t imports;
+
+	try
 	{
-		return Term(std::move(binOpOpt.value()));
+		scanFuncDefs(source, funcs, imports);
 	}
-	else if (auto casesOpt = parseCases())
+	catch (const ParseError &error)
 	{
-		if (std::holds_alternative<CasesTerm<Prim_t>>(casesOpt.value()))
-		{
-			return Term(std::move(std::get<CasesTerm<Prim_t>>(casesOpt.value())));
-		}
-		else if (std::holds_alternative<CasesTerm<Loc_t>>(casesOpt.value()))
-		{
-			return Term(std::move(std::get<CasesTerm<Loc_t>>(casesOpt.value())));
-		}
+		return error.Report;
 	}
 
 	return std::nullopt;
 }
 
-std::optional<VarTerm> Parser::parseVar()
+std::optional<std::string> Parser::tryParseFuncDefs(std::string_view source, size_t begin, size_t end,
+	TermArena &arena, Program::FuncDefs_t &funcs)
 {
-	if (m_Lexer->isPeekToken(Token::Id))
+	Program::Imports_t imports;
+
+	try
 	{
-		if (auto varOpt = m_Lexer->getPeekBuffer())
-		{
-			if (m_Lexer->isPeekToken(Token::Dot, 1))
-			{
-				m_Lexer->next();
-				m_Lexer->next();
-				
-				if (auto bodyOpt = parseTerm())
-				{
-					return VarTerm(varOpt.value(), std::move(bodyOpt.value()));
-				}
-				else
-				{
-					parseError("Expected term after variable '" + varOpt.value() + "'", *m_Lexer);
-				}
-			}
-			else if (m_Lexer->isPeekToken(Token::Comma, 1) ||
-					 m_Lexer->isPeekToken(Token::Rsb, 1) ||
-					 m_Lexer->isPeekToken(Token::Rb, 1) ||
-					 m_Lexer->isPeekToken(Token::Eof, 1))
-			{
-				m_Lexer->next();
-				return VarTerm(varOpt.value());
-			}
-		}
+		parseFuncDefs(source, begin, end, arena, funcs, imports);
+	}
+	catch (const ParseError &error)
+	{
+		m_Arena = nullptr;
+		return error.Report;
 	}
 
 	return std::nullopt;
 }
 
-std::optional<AbsTerm> Parser::parseAbs()
+bool Parser::parseImport(Program::Imports_t &imports)
 {
-	std::optional<std::string> locOpt;
-
-	if (m_Lexer->isPeekToken(Token::Id) &&
-		m_Lexer->isPeekToken(Token::Lab, 1) &&
-		!m_Lexer->isPeekToken(Token::Ampersand, 2))
+	if (m_Lexer->isPeekToken(Token::Id) && m_Lexer->getPeekBuffer().value() == "import" && m_Lexer->isPeekToken(Token::Id, 1))
 	{
-		locOpt = m_Lexer->getPeekBuffer();
 		m_Lexer->next();
+		imports.push_back(internSymbol(m_Lexer->getPeekBuffer().value()));
+		m_Lexer->next();
+		return true;
 	}
 
-	if (m_Lexer->isPeekToken(Token::Lab) &&
-		!m_Lexer->isPeekToken(Token::Ampersand, 1))
+	return false;
+}
+
+Var_t Parser::qualifyFunc(std::string_view name) const
+{
+	if (m_ModuleName.empty())
 	{
-		m_Lexer->next();
+		return internSymbol(name);
+	}
 
-		std::optional<std::string> varOpt;
-		
-		if (m_Lexer->isPeekToken(Token::Id))
+	return internSymbol(m_ModuleName + "::" + std::string(name));
+}
+
+void Parser::scanFuncDefs(std::string_view source, Program::FuncRanges_t &funcs, Program::Imports_t &imports)
+{
+	m_Lexer = std::make_unique<Lexer>(source);
+
+	// The term of each definition is skipped by balancing its parentheses
+	while (!m_Lexer->isPeekToken(Token::Eof))
+	{
+		if (parseImport(imports))
 		{
-			varOpt = m_Lexer->getPeekBuffer();
-			m_Lexer->next();
+			continue;
 		}
-		else if (m_Lexer->isPeekToken(Token::Underscore))
+
+		if (!m_Lexer->isPeekToken(Token::Id))
 		{
-			m_Lexer->next();
+			parseError("Expected function declaration", *m_Lexer);
 		}
-		else
+
+		size_t begin = m_Lexer->getPeekPos().value();
+		std::string_view func = m_Lexer->getPeekBuffer().value();
+		m_Lexer->next();
+
+		if (!m_Lexer->isPeekToken(Token::Equal))
 		{
-			parseError("Expected binding variable of abstraction", *m_Lexer);
+			parseError("Expected '=' after declaration of function '" + std::string(func) + "'", *m_Lexer);
 		}
+		m_Lexer->next();
 
-		if (m_Lexer->isPeekToken(Token::Rab))
+		if (!m_Lexer->isPeekToken(Token::Lb))
 		{
-			m_Lexer->next();
+			parseError("Expected '(' before definition of function '" + std::string(func) + "'", *m_Lexer);
+		}
+		m_Lexer->next();
 
-			if (m_Lexer->isPeekToken(Token::Dot))
+		size_t depth = 1;
+		while (depth > 0)
+		{
+			if (m_Lexer->isPeekToken(Token::Eof))
 			{
-				m_Lexer->next();
-				
-				if (auto bodyOpt = parseTerm())
-				{
-					return AbsTerm(
-						locOpt.value_or(k_LambdaLoc), varOpt,
-						std::move(bodyOpt.value())
-					);
-				}
-				else
-				{
-					parseError("Expected term after abstraction", *m_Lexer);
-				}
+				parseError("Expected ')' after definition of function '" + std::string(func) + "'", *m_Lexer);
+			}
+			else if (m_Lexer->isPeekToken(Token::Lb))
+			{
+				depth++;
+			}
+			else if (m_Lexer->isPeekToken(Token::Rb))
+			{
+				depth--;
 			}
 
-			return AbsTerm(
-				locOpt.value_or(k_LambdaLoc), varOpt
-			);
-		}
-		else
-		{
-			parseError("Expected closing '>' of abstraction", *m_Lexer);
+			if (depth == 0)
+			{
+				funcs[internSymbol(func)] = { begin, m_Lexer->getPeekPos().value() + 1 };
+			}
+			m_Lexer->next();
 		}
 	}
-
-	return std::nullopt;
 }
 
-std::optional<AppTerm> Parser::parseApp()
+void Parser::parseFuncDefs(std::string_view source, size_t begin, size_t end,
+	TermArena &arena, Program::FuncDefs_t &funcs, Program::Imports_t &imports)
 {
-	if (m_Lexer->isPeekToken(Token::Lsb) &&
-		!m_Lexer->isPeekToken(Token::Hash, 1))
+	m_Lexer = std::make_unique<Lexer>(source, begin);
+	m_Arena = &arena;
+
+	// Definitions are parsed until one starts at (or after) 'end'
+	while (!m_Lexer->isPeekToken(Token::Eof) && m_Lexer->getPeekPos().value() < end)
 	{
-		m_Lexer->next();
-		
-		if (auto argOpt = parseTerm())
+		if (parseImport(imports))
+		{
+			continue;
+		}
+
+		if (m_Lexer->isPeekToken(Token::Id))
 		{
-			if (m_Lexer->isPeekToken(Token::Rsb))
+			if (auto funcOpt = m_Lexer->getPeekBuffer())
 			{
 				m_Lexer->next();
 
-				std::optional<std::string> locOpt;
-
-				if (m_Lexer->isPeekToken(Token::Id))
+				if (m_Lexer->isPeekToken(Token::Equal))
 				{
-					locOpt = m_Lexer->getPeekBuffer();
 					m_Lexer->next();
-				}
 
-				if (m_Lexer->isPeekToken(Token::Dot))
-				{
-					m_Lexer->next();
-					
-					if (auto bodyOpt = parseTerm())
+					if (m_Lexer->isPeekToken(Token::Lb))
 					{
-						return AppTerm(
-							locOpt.value_or(k_LambdaLoc),
-							std::move(argOpt.value()),
-							std::move(bodyOpt.value())
-						);
+						m_Lexer->next();
+
+						if (auto termOpt = parseTerm())
+						{
+							if (m_Lexer->isPeekToken(Token::Rb))
+							{
+								m_Lexer->next();
+								funcs[qualifyFunc(funcOpt.value())] = termOpt.value();
+							}
+							else
+							{
+								parseError("Expected ')' after definition of function '" + std::string(funcOpt.value()) + "'", *m_Lexer);
+							}
+						}
+						else
+						{
+							parseError("Expected term for definition of function '" + std::string(funcOpt.value()) + "'", *m_Lexer);
+						}
 					}
 					else
 					{
-						parseError("Expected term after application", *m_Lexer);
+						parseError("Expected '(' before definition of function '" + std::string(funcOpt.value()) + "'", *m_Lexer);
 					}
 				}
-
-				return AppTerm(
-					locOpt.value_or(k_LambdaLoc),
-					std::move(argOpt.value())
-				);
-			}
-			else
-			{
-				parseError("Expected closing ']' of application", *m_Lexer);
+				else
+				{
+					parseError("Expected '=' after declaration of function '" + std::string(funcOpt.value()) + "'", *m_Lexer);
+				}
 			}
 		}
 		else
 		{
-			parseError("Expected inner term of application", *m_Lexer);
+			parseError("Expected function declaration", *m_Lexer);
 		}
 	}
 
-	return std::nullopt;
+	m_Arena = nullptr;
 }
 
-std::optional<LocAbsTerm> Parser::parseLocAbs()
+std::optional<TermIdx_t> Parser::parseTerm()
 {
-	std::optional<std::string> locOpt;
+	// The heads of a sequence are parsed in a loop (rather than recursing for
+	// each body), then added back to front as each term's body must be added
+	// before it. Only nested terms (arguments & cases) recurse.
+	std::vector<PendingTerm> pending;
 
-	if (m_Lexer->isPeekToken(Token::Id) &&
-		m_Lexer->isPeekToken(Token::Lab, 1) &&
-		m_Lexer->isPeekToken(Token::Ampersand, 2))
-	{
-		locOpt = m_Lexer->getPeekBuffer();
-		m_Lexer->next();
-	}
+	// Variables bound within the sequence go out of scope at the end of it
+	size_t numBoundVars = m_BoundVars.size();
 
-	if (m_Lexer->isPeekToken(Token::Lab) &&
-		m_Lexer->isPeekToken(Token::Ampersand, 1))
+	do
 	{
-		m_Lexer->next();
-		m_Lexer->next();
-
-		std::optional<std::string> varOpt;
-		
-		if (m_Lexer->isPeekToken(Token::Id))
+		if (auto headOpt = parseHead())
 		{
-			varOpt = m_Lexer->getPeekBuffer();
-			m_Lexer->next();
+			pending.push_back(std::move(headOpt.value()));
 		}
-		else if (m_Lexer->isPeekToken(Token::Underscore))
+		else if (pending.empty())
 		{
-			m_Lexer->next();
+			return std::nullopt;
 		}
 		else
 		{
-			parseError("Expected binding variable of abstraction", *m_Lexer);
+			const Term &head = pending.back().Head;
+
+			if      (head.isVar())    { parseError("Expected term after variable '" + getSymbolName(head.asVar().getVar()) + "'", *m_Lexer); }
+			else if (head.isAbs())    { parseError("Expected term after abstraction", *m_Lexer); }
+			else if (head.isLocAbs()) { parseError("Expected term after abstraction", *m_Lexer); }
+			else if (head.isBinOp())  { parseError("Expected term after binary operation", *m_Lexer); }
+			else if (head.isPrimCases() || head.isLocCases())
+			{
+				parseError("Expected term after cases", *m_Lexer);
+			}
+			else
+			{
+				parseError("Expected term after application", *m_Lexer);
+			}
 		}
+	}
+	while (pending.back().HasBody);
 
-		if (m_Lexer->isPeekToken(Token::Rab))
+	TermIdx_t body = k_NilTermIdx;
+
+	for (auto itPending = pending.rbegin(); itPending != pending.rend(); ++itPending)
+	{
+		body = m_Arena->add(std::move(itPending->Head), body, itPending->Arg, itPending->Cases);
+
+		if (m_IsFusionEnabled)
 		{
-			m_Lexer->next();
-			
-			if (m_Lexer->isPeekToken(Token::Dot))
-			{
-				m_Lexer->next();
+			body = fuseTerm(*m_Arena, body);
+		}
+	}
 
-				if (auto bodyOpt = parseTerm())
-				{
-					return LocAbsTerm(
-						locOpt.value_or(k_LambdaLoc), varOpt,
-						std::move(bodyOpt.value())
-					);
-				}
-				else
-				{
-					parseError("Expected term after abstraction", *m_Lexer);
-				}
-			}
+	m_BoundVars.resize(numBoundVars);
+
+	return body;
+}
 
-			return LocAbsTerm(
-				locOpt.value_or(k_LambdaLoc), varOpt
-			);
+std::optional<Parser::PendingTerm> Parser::parseHead()
+{
+	// Productions are selected by the next token (or two, to tell apart the
+	// kinds of abstraction & application)
+	switch (m_Lexer->getPeekToken().value())
+	{
+	case Token::Asterisk:
+		m_Lexer->next();
+		return PendingTerm{Term(NilTerm())};
+	case Token::Id:
+		if (m_Lexer->isPeekToken(Token::Lab, 1))
+		{
+			return m_Lexer->isPeekToken(Token::Ampersand, 2) ? parseLocAbs() : parseAbs();
 		}
-		else
+		return parseVar();
+	case Token::Lab:
+		return m_Lexer->isPeekToken(Token::Ampersand, 1) ? parseLocAbs() : parseAbs();
+	case Token::Lsb:
+		return m_Lexer->isPeekToken(Token::Hash, 1) ? parseLocApp() : parseApp();
+	case Token::Primitive:
+		return parseVal();
+	case Token::Plus:
+	case Token::Minus:
+		return parseBinOp();
+	case Token::Lb:
+		return parseCases();
+	default:
+		return std::nullopt;
+	}
+}
+
+bool Parser::parseDot()
+{
+	if (m_Lexer->isPeekToken(Token::Dot))
+	{
+		m_Lexer->next();
+		return true;
+	}
+
+	return false;
+}
+
+std::optional<Parser::PendingTerm> Parser::parseVar()
+{
+	if (auto varOpt = m_Lexer->getPeekBuffer())
+	{
+		if (m_Lexer->isPeekToken(Token::Dot, 1) ||
+			m_Lexer->isPeekToken(Token::Comma, 1) ||
+			m_Lexer->isPeekToken(Token::Rsb, 1) ||
+			m_Lexer->isPeekToken(Token::Rb, 1) ||
+			m_Lexer->isPeekToken(Token::Eof, 1))
 		{
-			parseError("Expected closing '>' of abstraction", *m_Lexer);
+			m_Lexer->next();
+
+			Var_t var = internSymbol(varOpt.value());
+
+			// References to the definitions of a module are qualified, unless bound
+			if (m_ModuleFuncs.contains(var) && std::find(m_BoundVars.begin(), m_BoundVars.end(), var) == m_BoundVars.end())
+			{
+				var = qualifyFunc(varOpt.value());
+			}
+
+			PendingTerm varTerm{Term(VarTerm(var))};
+			varTerm.HasBody = parseDot();
+			return varTerm;
 		}
 	}
 
 	return std::nullopt;
 }
 
-std::optional<LocAppTerm> Parser::parseLocApp()
+std::optional<Parser::PendingTerm> Parser::parseAbs()
 {
-	if (m_Lexer->isPeekToken(Token::Lsb) &&
-		m_Lexer->isPeekToken(Token::Hash, 1))
+	Loc_t loc = k_LambdaLoc;
+
+	if (m_Lexer->isPeekToken(Token::Id))
+	{
+		loc = internSymbol(m_Lexer->getPeekBuffer().value());
+		m_Lexer->next();
+	}
+
+	m_Lexer->next();
+
+	std::optional<Var_t> varOpt;
+
+	if (m_Lexer->isPeekToken(Token::Id))
 	{
+		varOpt = internSymbol(m_Lexer->getPeekBuffer().value());
 		m_Lexer->next();
+	}
+	else if (m_Lexer->isPeekToken(Token::Underscore))
+	{
 		m_Lexer->next();
-		
-		if (m_Lexer->isPeekToken(Token::Id))
+	}
+	else
+	{
+		parseError("Expected binding variable of abstraction", *m_Lexer);
+	}
+
+	if (m_Lexer->isPeekToken(Token::Rab))
+	{
+		m_Lexer->next();
+
+		if (varOpt && !m_ModuleName.empty())
 		{
-			if (auto argOpt = m_Lexer->getPeekBuffer())
-			{
-				m_Lexer->next();
+			m_BoundVars.push_back(varOpt.value());
+		}
 
-				if (m_Lexer->isPeekToken(Token::Rsb))
-				{
-					m_Lexer->next();
+		PendingTerm abs{Term(AbsTerm(loc, varOpt))};
+		abs.HasBody = parseDot();
+		return abs;
+	}
+	else
+	{
+		parseError("Expected closing '>' of abstraction", *m_Lexer);
+	}
 
-					std::optional<std::string> locOpt;
+	return std::nullopt;
+}
 
-					if (m_Lexer->isPeekToken(Token::Id))
-					{
-						locOpt = m_Lexer->getPeekBuffer();
-						m_Lexer->next();
-					}
+std::optional<Parser::PendingTerm> Parser::parseApp()
+{
+	m_Lexer->next();
 
-					if (m_Lexer->isPeekToken(Token::Dot))
-					{
-						m_Lexer->next();
-						
-						if (auto bodyOpt = parseTerm())
-						{
-							return LocAppTerm(
-								locOpt.value_or(k_LambdaLoc),
-								argOpt.value(),
-								std::move(bodyOpt.value())
-							);
-						}
-						else
-						{
-							parseError("Expected term after application", *m_Lexer);
-						}
-					}
+	if (auto argOpt = parseTerm())
+	{
+		if (m_Lexer->isPeekToken(Token::Rsb))
+		{
+			m_Lexer->next();
 
-					return LocAppTerm(
-						locOpt.value_or(k_LambdaLoc),
-						argOpt.value()
-					);
-				}
-				else
-				{
-					parseError("Expected closing ']' of application", *m_Lexer);
-				}
+			Loc_t loc = k_LambdaLoc;
+
+			if (m_Lexer->isPeekToken(Token::Id))
+			{
+				loc = internSymbol(m_Lexer->getPeekBuffer().value());
+				m_Lexer->next();
 			}
+
+			PendingTerm app{Term(AppTerm(loc)), argOpt.value()};
+			app.HasBody = parseDot();
+			return app;
 		}
 		else
 		{
-			parseError("Expected inner term of application", *m_Lexer);
+			parseError("Expected closing ']' of application", *m_Lexer);
 		}
 	}
+	else
+	{
+		parseError("Expected inner term of application", *m_Lexer);
+	}
 
 	return std::nullopt;
 }
 
-std::optional<ValTerm> Parser::parseVal()
+std::optional<Parser::PendingTerm> Parser::parseLocAbs()
 {
-	if (m_Lexer->isPeekToken(Token::Primitive))
+	Loc_t loc = k_LambdaLoc;
+
+	if (m_Lexer->isPeekToken(Token::Id))
 	{
-		if (auto primOpt = m_Lexer->getPeekBuffer())
-		{
-			m_Lexer->next();
+		loc = internSymbol(m_Lexer->getPeekBuffer().value());
+		m_Lexer->next();
+	}
 
-			int prim = std::stoi(primOpt.value());
-			return ValTerm(
-				prim
-			);
-		}
+	m_Lexer->next();
+	m_Lexer->next();
+
+	std::optional<LocVar_t> varOpt;
+
+	if (m_Lexer->isPeekToken(Token::Id))
+	{
+		varOpt = internSymbol(m_Lexer->getPeekBuffer().value());
+		m_Lexer->next();
+	}
+	else if (m_Lexer->isPeekToken(Token::Underscore))
+	{
+		m_Lexer->next();
+	}
+	else
+	{
+		parseError("Expected binding variable of abstraction", *m_Lexer);
+	}
+
+	if (m_Lexer->isPeekToken(Token::Rab))
+	{
+		m_Lexer->next();
+
+		PendingTerm locAbs{Term(LocAbsTerm(loc, varOpt))};
+		locAbs.HasBody = parseDot();
+		return locAbs;
+	}
+	else
+	{
+		parseError("Expected closing '>' of abstraction", *m_Lexer);
 	}
 
 	return std::nullopt;
 }
 
-std::optional<BinOpTerm> Parser::parseBinOp()
+std::optional<Parser::PendingTerm> Parser::parseLocApp()
 {
-	if (m_Lexer->isPeekToken(Token::Plus) ||
-		m_Lexer->isPeekToken(Token::Minus))
-	{
-		BinOpTerm::Op op;
-		if (m_Lexer->isPeekToken(Token::Plus))
-		{
-			op = BinOpTerm::Plus;
-		}
-		else if (m_Lexer->isPeekToken(Token::Minus))
-		{
-			op = BinOpTerm::Minus;
-		}
+	m_Lexer->next();
+	m_Lexer->next();
 
+	if (m_Lexer->isPeekToken(Token::Id))
+	{
+		LocVar_t arg = internSymbol(m_Lexer->getPeekBuffer().value());
 		m_Lexer->next();
 
-		if (m_Lexer->isPeekToken(Token::Dot))
+		if (m_Lexer->isPeekToken(Token::Rsb))
 		{
 			m_Lexer->next();
 
-			if (auto bodyOpt = parseTerm())
-			{
-				return BinOpTerm(
-					op, std::move(bodyOpt.value())
-				);
-			}
-			else
+			Loc_t loc = k_LambdaLoc;
+
+			if (m_Lexer->isPeekToken(Token::Id))
 			{
-				parseError("Expected term after binary operation", *m_Lexer);
+				loc = internSymbol(m_Lexer->getPeekBuffer().value());
+				m_Lexer->next();
 			}
-		}
 
-		return BinOpTerm(
-			op
-		);
+			PendingTerm locApp{Term(LocAppTerm(loc, arg))};
+			locApp.HasBody = parseDot();
+			return locApp;
+		}
+		else
+		{
+			parseError("Expected closing ']' of application", *m_Lexer);
+		}
+	}
+	else
+	{
+		parseError("Expected inner term of application", *m_Lexer);
 	}
 
 	return std::nullopt;
 }
 
-std::optional<std::variant<CasesTerm<Prim_t>, CasesTerm<Loc_t>>> Parser::parseCases()
+std::optional<Parser::PendingTerm> Parser::parseVal()
+{
+	Prim_t prim = parsePrim(m_Lexer->getPeekBuffer().value(), *m_Lexer);
+	m_Lexer->next();
+
+	return PendingTerm{Term(ValTerm(prim))};
+}
+
+std::optional<Parser::PendingTerm> Parser::parseBinOp()
 {
-	if (m_Lexer->isPeekToken(Token::Lb))
+	BinOpTerm::Op op = m_Lexer->isPeekToken(Token::Plus) ? BinOpTerm::Plus : BinOpTerm::Minus;
+	m_Lexer->next();
+
+	PendingTerm binOp{Term(BinOpTerm(op))};
+	binOp.HasBody = parseDot();
+	return binOp;
+}
+
+std::optional<Parser::PendingTerm> Parser::parseCases()
+{
+	m_Lexer->next();
+
+	std::optional<TermIdx_t> otherwiseCaseOpt;
+	std::vector<std::pair<Prim_t, TermIdx_t>> primCases;
+	std::vector<std::pair<Loc_t, TermIdx_t>> locCases;
+
+	// Later cases for the same value replace earlier ones
+	auto setCase = [](auto &cases, auto value, TermIdx_t term) {
+		for (auto &c : cases)
+		{
+			if (c.first == value)
+			{
+				c.second = term;
+				return;
+			}
+		}
+		cases.emplace_back(value, term);
+	};
+
+	bool isCaseRemaining = true;
+	while (isCaseRemaining)
 	{
-		m_Lexer->next();
+		std::optional<Prim_t> primOpt;
+		std::optional<std::string_view> locOpt;
+		bool isOtherwise = false;
 
-		std::optional<TermOwner_t> otherwiseCaseOpt;
-		CasesTerm<Prim_t>::Cases_t primCases;
-		CasesTerm<Loc_t>::Cases_t locCases;
+		if (m_Lexer->isPeekToken(Token::Primitive))
+		{
+			primOpt = parsePrim(m_Lexer->getPeekBuffer().value(), *m_Lexer);
+			m_Lexer->next();
+		}
+		else if (m_Lexer->isPeekToken(Token::Id))
+		{
+			locOpt = m_Lexer->getPeekBuffer();
+			isOtherwise = (locOpt.value() == "otherwise");
+			m_Lexer->next();
+		}
+		else
+		{
+			parseError("Expected a case for cases", *m_Lexer);
+		}
+
+		std::string caseName = isOtherwise ? "otherwise" : (primOpt ? std::to_string(primOpt.value()) : std::string(locOpt.value()));
 
-		bool isCaseRemaining = true;
-		while (isCaseRemaining)
+		if (m_Lexer->isPeekToken(Token::Arrow))
 		{
-			std::optional<Prim_t> primOpt;
-			std::optional<Loc_t> locOpt;
-			bool isOtherwise = false;
+			m_Lexer->next();
 
-			if (m_Lexer->isPeekToken(Token::Primitive))
+			if (auto termOpt = parseTerm())
 			{
-				if (auto primStrOpt = m_Lexer->getPeekBuffer())
+				if (isOtherwise)
 				{
-					m_Lexer->next();
-					int prim = std::stoi(primStrOpt.value());
-					primOpt = prim;
+					otherwiseCaseOpt = termOpt.value();
 				}
-			}
-			else if (m_Lexer->isPeekToken(Token::Id))
-			{
-				if (auto idOpt = m_Lexer->getPeekBuffer())
+				else if (primOpt)
 				{
-					m_Lexer->next();
-					locOpt = idOpt.value();
-					isOtherwise = (idOpt.value() == "otherwise");
+					setCase(primCases, primOpt.value(), termOpt.value());
 				}
-			}
-			else
-			{
-				parseError("Expected a case for cases", *m_Lexer);
-			}
-
-			if (m_Lexer->isPeekToken(Token::Arrow))
-			{
-				m_Lexer->next();
-
-				if (auto termOpt = parseTerm())
+				else if (locOpt)
 				{
-					if (isOtherwise)
-					{
-						otherwiseCaseOpt = newTerm(std::move(termOpt.value()));
-					}
-					else if (primOpt)
-					{
-						primCases[primOpt.value()] = newTerm(std::move(termOpt.value()));
-					}
-					else if (locOpt)
-					{
-						locCases[locOpt.value()] = newTerm(std::move(termOpt.value()));
-					}
+					setCase(locCases, internSymbol(locOpt.value()), termOpt.value());
+				}
 
-					if (m_Lexer->isPeekToken(Token::Comma))
-					{
-						m_Lexer->next();
-						isCaseRemaining = true;
-					}
-					else
-					{
-						isCaseRemaining = false;
-					}
+				if (m_Lexer->isPeekToken(Token::Comma))
+				{
+					m_Lexer->next();
+					isCaseRemaining = true;
 				}
 				else
 				{
-					parseError("Expected mapping term for case '" +
-						(isOtherwise ? "otherwise" : (primOpt ? std::to_string(primOpt.value()) : locOpt.value())) +
-						"'", *m_Lexer
-					);
+					isCaseRemaining = false;
 				}
 			}
 			else
 			{
-				parseError("Expected '->' after case '" +
-					(isOtherwise ? "otherwise" : (primOpt ? std::to_string(primOpt.value()) : locOpt.value())) +
-					"'", *m_Lexer
-				);
+				parseError("Expected mapping term for case '" + caseName + "'", *m_Lexer);
 			}
 		}
-
-		// TODO: valiate that only one sort of cases were found !
-
-		if (m_Lexer->isPeekToken(Token::Rb))
+		else
 		{
-			m_Lexer->next();
+			parseError("Expected '->' after case '" + caseName + "'", *m_Lexer);
+		}
+	}
 
-			if (otherwiseCaseOpt)
-			{
-				if (m_Lexer->isPeekToken(Token::Dot))
-				{
-					m_Lexer->next();
+	// TODO: valiate that only one sort of cases were found !
 
-					if (auto bodyOpt = parseTerm())
-					{
-						if (primCases.size() > 0)
-						{
-							return CasesTerm<Prim_t>(
-								std::move(primCases), std::move(otherwiseCaseOpt.value()),
-								std::move(bodyOpt.value())
-							);
-						}
-						else if (locCases.size() > 0)
-						{
-							return CasesTerm<Loc_t>(
-								std::move(locCases), std::move(otherwiseCaseOpt.value()),
-								std::move(bodyOpt.value())
-							);
-						}
-					}
-				}
+	if (m_Lexer->isPeekToken(Token::Rb))
+	{
+		m_Lexer->next();
 
-				if (primCases.size() > 0)
-				{
-					return CasesTerm<Prim_t>(
-						std::move(primCases), std::move(otherwiseCaseOpt.value())
-					);
-				}
-				else if (locCases.size() > 0)
-				{
-					return CasesTerm<Loc_t>(
-						std::move(locCases), std::move(otherwiseCaseOpt.value())
-					);
-				}
-			}
-			else
+		if (!otherwiseCaseOpt)
+		{
+			parseError("Required an 'otherwise' case for cases", *m_Lexer);
+		}
+
+		// Cases are stored consecutively (in order), after everything they refer to
+		std::sort(primCases.begin(), primCases.end(), [](const auto &a, const auto &b) {
+			return a.first < b.first;
+		});
+		std::sort(locCases.begin(), locCases.end(), [](const auto &a, const auto &b) {
+			return getSymbolName(a.first) < getSymbolName(b.first);
+		});
+
+		auto addCases = [&](auto &values) {
+			std::vector<std::pair<ValTerm, TermIdx_t>> cases;
+			for (auto &c : values)
 			{
-				parseError("Required an 'otherwise' case for cases", *m_Lexer);
+				cases.emplace_back(ValTerm(c.first), c.second);
 			}
+			return m_Arena->addCases(std::move(cases));
+		};
+
+		if (primCases.size() > 0)
+		{
+			uint32_t numCases = static_cast<uint32_t>(primCases.size());
+			PendingTerm cases{Term(CasesTerm<Prim_t>(numCases)), otherwiseCaseOpt.value(), addCases(primCases)};
+			cases.HasBody = parseDot();
+			return cases;
+		}
+		else if (locCases.size() > 0)
+		{
+			uint32_t numCases = static_cast<uint32_t>(locCases.size());
+			PendingTerm cases{Term(CasesTerm<Loc_t>(numCases)), otherwiseCaseOpt.value(), addCases(locCases)};
+			cases.HasBody = parseDot();
+			return cases;
+		}
+		else
+		{
+			parseError("Required a case other than 'otherwise' for cases", *m_Lexer);
 		}
 	}
 
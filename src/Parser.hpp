@@ -3,8 +3,9 @@
 #include <memory>
 #include <optional>
 #include <string>
-#include <stack>
-#include <variant>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
 
 #include "Config.hpp"
 #include "Lexer.hpp"
@@ -16,27 +17,98 @@ class Parser
 public:
 	Parser();
 
-	Program parseProgram(const std::string &programSrc);
-	std::optional<Term> parseTerm(const std::string &termSrc);
+	// Superinstructions are recognised by default, see 'Fusion.hpp'
+	void setFusion(bool isEnabled);
+
+	// Structurally identical terms of a program are stored once, see 'TermArena'
+	void setSharing(bool isEnabled);
+
+	// Large programs are split into their definitions, which are parsed
+	// concurrently on this many threads (one by default)
+	void setThreads(size_t numThreads);
+
+	// Definitions are only delimited when the program is parsed, each being
+	// parsed when first loaded, see 'Program'
+	void setLazy(bool isEnabled);
+
+	Program parseProgram(std::string_view programSrc);
+	// As 'parseProgram', though parse errors are returned (as the report which
+	// would've been displayed) rather than exiting. The program is always
+	// parsed eagerly, so every error is found up front.
+	std::optional<std::string> tryParseProgram(std::string_view programSrc, std::optional<Program> &program);
+	// The term is added to (and owned by) 'arena'
+	std::optional<TermHandle_t> parseTerm(std::string_view termSrc, TermArena &arena);
+	std::optional<std::string> tryParseTerm(std::string_view termSrc, TermArena &arena,
+		std::optional<TermHandle_t> &term);
+	// The terms of the definitions within [begin, end) are added to 'arena'
+	Program::FuncDefs_t parseFuncDefs(std::string_view source, size_t begin, size_t end, TermArena &arena);
+
+	// Parses the source of an imported module, whose definitions are named
+	// 'moduleName::name'. References to them within the module are renamed
+	// too, unless the name is bound by an abstraction.
+	Program::FuncDefs_t parseModule(std::string_view source, std::string_view moduleName,
+		TermArena &arena, Program::Imports_t &imports);
+
+	// As 'scanFuncDefs' & 'parseFuncDefs', though parse errors are returned
+	// (as the report which would've been displayed) rather than exiting
+	std::optional<std::string> tryScanFuncDefs(std::string_view source, Program::FuncRanges_t &funcs);
+	std::optional<std::string> tryParseFuncDefs(std::string_view source, size_t begin, size_t end,
+		TermArena &arena, Program::FuncDefs_t &funcs);
 
 private:
-	Program::FuncDefs_t parseFuncDefs();
+	// Parses every definition of the program (concurrently, when it's large)
+	void parseProgram(std::string_view programSrc, TermArena &arena, Program::FuncDefs_t &funcs,
+		Program::Imports_t &imports);
+
+	// Finds the range of each definition, without parsing its term
+	void scanFuncDefs(std::string_view source, Program::FuncRanges_t &funcs, Program::Imports_t &imports);
 
-	std::optional<Term> parseTerm();
+	// Parses the definitions starting within [begin, end) of the source
+	void parseFuncDefs(std::string_view source, size_t begin, size_t end,
+		TermArena &arena, Program::FuncDefs_t &funcs, Program::Imports_t &imports);
 
-	std::optional<VarTerm> parseVar();
-	std::optional<AbsTerm> parseAbs();
-	std::optional<AppTerm> parseApp();
-	std::optional<LocAbsTerm> parseLocAbs();
-	std::optional<LocAppTerm> parseLocApp();
+	// 'import name' declarations between definitions
+	bool parseImport(Program::Imports_t &imports);
 
-	std::optional<ValTerm> parseVal();
-	std::optional<BinOpTerm> parseBinOp();
-	
-	std::optional<std::variant<
-		CasesTerm<Prim_t>, CasesTerm<Loc_t>
-	>> parseCases(); 
+	// Name of a definition or reference to one, qualified when parsing a module
+	Var_t qualifyFunc(std::string_view name) const;
+
+	// A term of a sequence, waiting for the rest of the sequence (its body)
+	struct PendingTerm
+	{
+		Term Head;
+		TermIdx_t Arg = k_NoTermIdx;
+		TermIdx_t Cases = k_NoTermIdx;
+		bool HasBody = false;
+	};
+
+	std::optional<TermIdx_t> parseTerm();
+	std::optional<PendingTerm> parseHead();
+	bool parseDot();
+
+	std::optional<PendingTerm> parseVar();
+	std::optional<PendingTerm> parseAbs();
+	std::optional<PendingTerm> parseApp();
+	std::optional<PendingTerm> parseLocAbs();
+	std::optional<PendingTerm> parseLocApp();
+
+	std::optional<PendingTerm> parseVal();
+	std::optional<PendingTerm> parseBinOp();
+	std::optional<PendingTerm> parseCases();
 
 private:
 	std::unique_ptr<Lexer> m_Lexer;
+	TermArena *m_Arena;
+	bool m_IsFusionEnabled;
+	bool m_IsSharingEnabled;
+	size_t m_NumThreads;
+	bool m_IsLazyEnabled;
+
+	// Only set while parsing a module
+	std::string m_ModuleName;
+	std::unordered_set<Var_t> m_ModuleFuncs;
+	std::vector<Var_t> m_BoundVars;
+
+	// Smaller programs are always parsed serially
+	static const size_t s_MinParallelSize = 64 * 1024;
 };
\ No newline at end of file
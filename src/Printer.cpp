@@ -0,0 +1,514 @@
+#include "Printer.hpp"
+
+#include <charconv>
+#include <cstring>
+
+#include "Utils.hpp"
+
+void Printer::setMaxSize(size_t size)
+{
+	m_MaxSize = size;
+}
+
+void Printer::setMaxDepth(size_t depth)
+{
+	m_MaxDepth = depth;
+}
+
+void Printer::printTerm(std::string &out, TermHandle_t term, bool omitNil)
+{
+	begin(out);
+	appendTerm(term, omitNil);
+}
+
+void Printer::printClosure(std::string &out, const Closure_t &closure, bool omitNil)
+{
+	printClosure(out, closure.first, closure.second, omitNil);
+}
+
+void Printer::printClosure(std::string &out, const Env_t &env, TermHandle_t term, bool omitNil)
+{
+	begin(out);
+	appendClosure(env, term, omitNil);
+	unshadow(0);
+	m_Rendered.clear();
+}
+
+void Printer::printPrim(std::string &out, Prim_t prim)
+{
+	char chars[16];
+	auto [end, ec] = std::to_chars(chars, chars + sizeof(chars), prim);
+	out.append(chars, end);
+}
+
+void Printer::printLoc(std::string &out, Loc_t loc)
+{
+	out += '#';
+	out += getLocName(loc);
+}
+
+void Printer::begin(std::string &out)
+{
+	m_Out = &out;
+	m_Begin = out.size();
+	m_Depth = 0;
+	m_IsTruncated = false;
+}
+
+void Printer::appendTerm(TermHandle_t term, bool omitNil)
+{
+	if (!enter())
+	{
+		return;
+	}
+
+	for (int i = 0; term && !isFull(); ++i)
+	{
+		if (i > 0 && (!omitNil || !term->isNil()))
+		{
+			append(" . ");
+		}
+
+		if (term->isNil())
+		{
+			if (!omitNil)
+			{
+				append('*');
+			}
+			term = nullptr;
+		}
+		else if (term->isVar())
+		{
+			append(getSymbolName(term->asVar().getVar()));
+			term = term->getBody();
+		}
+		else if (term->isAbs())
+		{
+			const AbsTerm &abs = term->asAbs();
+			if (abs.getLoc() != k_LambdaLoc)
+			{
+				append(getLocName(abs.getLoc()));
+			}
+			append('<');
+			append(abs.getVar() ? getSymbolName(abs.getVar().value()) : "_");
+			append('>');
+			term = term->getBody();
+		}
+		else if (term->isApp())
+		{
+			const AppTerm &app = term->asApp();
+			append('[');
+			appendTerm(term->getArg(), true);
+			append(']');
+			if (app.getLoc() != k_LambdaLoc)
+			{
+				append(getLocName(app.getLoc()));
+			}
+			term = term->getBody();
+		}
+		else if (term->isLocAbs())
+		{
+			const LocAbsTerm &locAbs = term->asLocAbs();
+			if (locAbs.getLoc() != k_LambdaLoc)
+			{
+				append(getLocName(locAbs.getLoc()));
+			}
+			append("<@");
+			append(locAbs.getLocVar() ? getSymbolName(locAbs.getLocVar().value()) : "_");
+			append('>');
+			term = term->getBody();
+		}
+		else if (term->isLocApp())
+		{
+			const LocAppTerm &locApp = term->asLocApp();
+			append("[#");
+			append(getLocName(locApp.getArg()));
+			append(']');
+			if (locApp.getLoc() != k_LambdaLoc)
+			{
+				append(getLocName(locApp.getLoc()));
+			}
+			term = term->getBody();
+		}
+		else if (term->isVal())
+		{
+			const ValTerm &val = term->asVal();
+			if (val.isPrim())
+			{
+				appendPrim(val.asPrim());
+			}
+			else
+			{
+				appendLoc(val.asLoc());
+			}
+			term = nullptr;
+		}
+		else if (term->isBinOp())
+		{
+			const BinOpTerm &binOp = term->asBinOp();
+			append(binOp.isOp(BinOpTerm::Plus) ? '+' : '-');
+			term = term->getBody();
+		}
+		else if (term->isPrimCases() || term->isLocCases())
+		{
+			uint32_t numCases = term->isPrimCases() ? term->asPrimCases().getNumCases() : term->asLocCases().getNumCases();
+
+			append('(');
+			for (uint32_t i = 0; i < numCases && !isFull(); ++i)
+			{
+				const ValTerm &val = term->getCase(i)->asVal();
+				if (val.isPrim())
+				{
+					appendPrim(val.asPrim());
+				}
+				else
+				{
+					append(getLocName(val.asLoc()));
+				}
+				append(" -> ");
+				appendTerm(term->getCase(i)->getArg(), true);
+				append(", ");
+			}
+			append("otherwise -> ");
+			appendTerm(term->getOtherwise(), true);
+			append(')');
+			term = term->getBody();
+		}
+		// Superinstructions are printed as the sequence they were fused from
+		else
+		{
+			--m_Depth;
+			appendTerm(term->getOriginal(), omitNil);
+			++m_Depth;
+			term = nullptr;
+		}
+	}
+
+	leave();
+}
+
+void Printer::appendClosure(const Env_t &env, TermHandle_t term, bool omitNil)
+{
+	if (!enter())
+	{
+		return;
+	}
+
+	for (int i = 0; term && !isFull(); ++i)
+	{
+		if (i > 0 && (!omitNil || !term->isNil()))
+		{
+			append(" . ");
+		}
+
+		if (term->isNil())
+		{
+			if (!omitNil)
+			{
+				append('*');
+			}
+			term = nullptr;
+		}
+		else if (term->isVar())
+		{
+			const VarTerm &var = term->asVar();
+
+			if (const Closure_t *binding = findBinding(env, var.getVar()))
+			{
+				appendBinding(*binding);
+			}
+			else
+			{
+				append(getSymbolName(var.getVar()));
+			}
+			term = term->getBody();
+		}
+		else if (term->isApp())
+		{
+			size_t mark = m_Shadows.size();
+
+			append('[');
+			appendClosure(env, term->getArg(), true);
+			append(']');
+			unshadow(mark);
+
+			locSuffix(env, term->asApp().getLoc());
+			term = term->getBody();
+		}
+		else if (term->isAbs())
+		{
+			const AbsTerm &abs = term->asAbs();
+
+			locSuffix(env, abs.getLoc());
+			append('<');
+			append(abs.getVar() ? getSymbolName(abs.getVar().value()) : "_");
+			append('>');
+
+			// The rest of the closure is under the binder
+			if (abs.getVar())
+			{
+				shadowVar(abs.getVar().value());
+			}
+			term = term->getBody();
+		}
+		else if (term->isLocApp())
+		{
+			const LocAppTerm &locApp = term->asLocApp();
+
+			append("[#");
+			append(getLocName(getLoc(env, locApp.getArg())));
+			append(']');
+
+			locSuffix(env, locApp.getLoc());
+			term = term->getBody();
+		}
+		else if (term->isLocAbs())
+		{
+			const LocAbsTerm &locAbs = term->asLocAbs();
+
+			locSuffix(env, locAbs.getLoc());
+
+			if (locAbs.getLocVar())
+			{
+				shadowLocVar(locAbs.getLocVar().value());
+			}
+
+			append("<@");
+			append(locAbs.getLocVar() ? getSymbolName(locAbs.getLocVar().value()) : "_");
+			append('>');
+			term = term->getBody();
+		}
+		else if (term->isVal())
+		{
+			const ValTerm &val = term->asVal();
+			if (val.isPrim())
+			{
+				appendPrim(val.asPrim());
+			}
+			else
+			{
+				appendLoc(val.asLoc());
+			}
+			term = nullptr;
+		}
+		else if (term->isBinOp())
+		{
+			const BinOpTerm &binOp = term->asBinOp();
+			append(binOp.isOp(BinOpTerm::Plus) ? '+' : '-');
+			term = term->getBody();
+		}
+		else if (term->isPrimCases() || term->isLocCases())
+		{
+			uint32_t numCases = term->isPrimCases() ? term->asPrimCases().getNumCases() : term->asLocCases().getNumCases();
+
+			append('(');
+			for (uint32_t i = 0; i < numCases && !isFull(); ++i)
+			{
+				const ValTerm &val = term->getCase(i)->asVal();
+				if (val.isPrim())
+				{
+					appendPrim(val.asPrim());
+				}
+				else
+				{
+					append(getLocName(val.asLoc()));
+				}
+				append(" -> ");
+
+				size_t mark = m_Shadows.size();
+				appendClosure(env, term->getCase(i)->getArg(), true);
+				unshadow(mark);
+
+				append(", ");
+			}
+			append("otherwise -> ");
+
+			size_t mark = m_Shadows.size();
+			appendClosure(env, term->getOtherwise(), true);
+			unshadow(mark);
+
+			append(')');
+			term = term->getBody();
+		}
+		// Superinstructions are printed as the sequence they were fused from
+		else
+		{
+			--m_Depth;
+			appendClosure(env, term->getOriginal(), omitNil);
+			++m_Depth;
+			term = nullptr;
+		}
+	}
+
+	leave();
+}
+
+void Printer::appendBinding(const Closure_t &closure)
+{
+	// Already rendered, so copied (the buffer is resized first, as it's both
+	// the source & destination)
+	auto itRendered = m_Rendered.find(&closure);
+	if (itRendered != m_Rendered.end())
+	{
+		if (m_IsTruncated)
+		{
+			return;
+		}
+
+		auto [offset, size] = itRendered->second;
+
+		size_t end = m_Out->size();
+		m_Out->resize(end + size);
+		std::memcpy(m_Out->data() + end, m_Out->data() + offset, size);
+		return;
+	}
+
+	// Bound closures are printed in their own scope
+	std::unordered_map<Var_t, uint32_t> shadowedVars;
+	std::unordered_map<LocVar_t, uint32_t> shadowedLocVars;
+	std::vector<std::pair<bool, Symbol_t>> shadows;
+
+	std::swap(shadowedVars, m_ShadowedVars);
+	std::swap(shadowedLocVars, m_ShadowedLocVars);
+	std::swap(shadows, m_Shadows);
+
+	size_t offset = m_Out->size();
+	size_t numCuts = m_NumCuts;
+	appendClosure(closure.first, closure.second, true);
+	unshadow(0);
+
+	std::swap(shadowedVars, m_ShadowedVars);
+	std::swap(shadowedLocVars, m_ShadowedLocVars);
+	std::swap(shadows, m_Shadows);
+
+	// Anything cut short by a limit isn't the whole closure
+	if (!m_IsTruncated && m_NumCuts == numCuts)
+	{
+		m_Rendered[&closure] = std::make_pair(offset, m_Out->size() - offset);
+	}
+}
+
+Loc_t Printer::getLoc(const Env_t &env, Loc_t loc) const
+{
+	if (m_ShadowedLocVars.find(loc) == m_ShadowedLocVars.end())
+	{
+		auto itEnv = env.second.find(loc);
+		if (itEnv != env.second.end())
+		{
+			return itEnv->second;
+		}
+	}
+	return loc;
+}
+
+void Printer::locSuffix(const Env_t &env, Loc_t loc)
+{
+	loc = getLoc(env, loc);
+	if (loc != k_LambdaLoc)
+	{
+		append(getLocName(loc));
+	}
+}
+
+const Closure_t *Printer::findBinding(const Env_t &env, Var_t var) const
+{
+	if (m_ShadowedVars.find(var) == m_ShadowedVars.end())
+	{
+		auto itEnv = env.first.find(var);
+		if (itEnv != env.first.end())
+		{
+			return reinterpret_cast<const Closure_t *>(itEnv->second.get());
+		}
+	}
+	return nullptr;
+}
+
+void Printer::shadowVar(Var_t var)
+{
+	m_ShadowedVars[var]++;
+	m_Shadows.emplace_back(false, var);
+}
+
+void Printer::shadowLocVar(LocVar_t var)
+{
+	m_ShadowedLocVars[var]++;
+	m_Shadows.emplace_back(true, var);
+}
+
+void Printer::unshadow(size_t mark)
+{
+	while (m_Shadows.size() > mark)
+	{
+		auto [isLocVar, var] = m_Shadows.back();
+		m_Shadows.pop_back();
+
+		auto &shadowed = isLocVar ? m_ShadowedLocVars : m_ShadowedVars;
+
+		auto itShadowed = shadowed.find(var);
+		if (--itShadowed->second == 0)
+		{
+			shadowed.erase(itShadowed);
+		}
+	}
+}
+
+bool Printer::enter()
+{
+	if (m_MaxDepth && m_Depth >= m_MaxDepth)
+	{
+		m_NumCuts++;
+		append("...");
+		return false;
+	}
+
+	++m_Depth;
+	return true;
+}
+
+void Printer::leave()
+{
+	--m_Depth;
+}
+
+bool Printer::isFull()
+{
+	if (m_MaxSize && m_Out->size() - m_Begin >= m_MaxSize)
+	{
+		if (!m_IsTruncated)
+		{
+			m_IsTruncated = true;
+			m_Out->append("...");
+		}
+		return true;
+	}
+	return false;
+}
+
+void Printer::append(std::string_view str)
+{
+	if (!m_IsTruncated)
+	{
+		m_Out->append(str);
+	}
+}
+
+void Printer::append(char c)
+{
+	if (!m_IsTruncated)
+	{
+		*m_Out += c;
+	}
+}
+
+void Printer::appendPrim(Prim_t prim)
+{
+	char chars[16];
+	auto [end, ec] = std::to_chars(chars, chars + sizeof(chars), prim);
+	append(std::string_view(chars, end - chars));
+}
+
+void Printer::appendLoc(Loc_t loc)
+{
+	append('#');
+	append(getLocName(loc));
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "Config.hpp"
+#include "Term.hpp"
+#include "Machine.hpp"
+
+// Prints terms & closures by appending to a buffer given by the caller, so a
+// buffer (and the printer) can be reused without allocating for each value.
+//
+// Closures are printed with their bindings substituted. Bound closures which
+// are shared (i.e. bound more than once in what's being printed) are only
+// rendered once, and copied from the buffer after that. Binders shadow the
+// environment with a scope rather than copying it, so printing is linear in
+// the size of the output.
+class Printer
+{
+public:
+	// At most 'size' characters are printed of each value, the rest being
+	// replaced by '...' (0 is no limit)
+	void setMaxSize(size_t size);
+	// Applications, cases & bindings nested deeper than 'depth' are printed as
+	// '...' (0 is no limit)
+	void setMaxDepth(size_t depth);
+
+	void printTerm(std::string &out, TermHandle_t term, bool omitNil = true);
+	void printClosure(std::string &out, const Closure_t &closure, bool omitNil = true);
+	void printClosure(std::string &out, const Env_t &env, TermHandle_t term, bool omitNil = true);
+
+	static void printPrim(std::string &out, Prim_t prim);
+	static void printLoc(std::string &out, Loc_t loc);
+
+private:
+	void begin(std::string &out);
+
+	void appendTerm(TermHandle_t term, bool omitNil);
+	void appendClosure(const Env_t &env, TermHandle_t term, bool omitNil);
+	void appendBinding(const Closure_t &closure);
+
+	// Location a (possibly bound) location is printed as
+	Loc_t getLoc(const Env_t &env, Loc_t loc) const;
+	void locSuffix(const Env_t &env, Loc_t loc);
+
+	// Binding of the variable, unless it's shadowed by a binder in the closure
+	const Closure_t *findBinding(const Env_t &env, Var_t var) const;
+
+	void shadowVar(Var_t var);
+	void shadowLocVar(LocVar_t var);
+	void unshadow(size_t mark);
+
+	// False (printing '...' once) when past a limit
+	bool enter();
+	void leave();
+	bool isFull();
+
+	// Nothing is appended once truncated, so the limit is kept by these alone
+	void append(std::string_view str);
+	void append(char c);
+	void appendPrim(Prim_t prim);
+	void appendLoc(Loc_t loc);
+
+private:
+	size_t m_MaxSize = 0;
+	size_t m_MaxDepth = 0;
+
+	std::string *m_Out = nullptr;
+	size_t m_Begin = 0;
+	size_t m_Depth = 0;
+	// Number of times the depth limit was reached
+	size_t m_NumCuts = 0;
+	bool m_IsTruncated = false;
+
+	// Variables (& location variables) shadowed in the current scope, with the
+	// order they were shadowed in so scopes can be undone
+	std::unordered_map<Var_t, uint32_t> m_ShadowedVars;
+	std::unordered_map<LocVar_t, uint32_t> m_ShadowedLocVars;
+	std::vector<std::pair<bool, Symbol_t>> m_Shadows;
+
+	// Offset & size of each bound closure rendered so far
+	std::unordered_map<const Closure_t *, std::pair<size_t, size_t>> m_Rendered;
+};
\ No newline at end of file
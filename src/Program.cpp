@@ -1,15 +1,279 @@
 #include "Program.hpp"
 
-Program::Program(FuncDefs_t &&funcs)
-	: m_Funcs(std::move(funcs))
+#include <sstream>
+
+#include "Parser.hpp"
+
+Program::Program(TermArena &&arena, FuncDefs_t &&funcs, Imports_t &&imports)
+	: m_Arena(std::move(arena))
+	, m_Imports(std::move(imports))
+{
+	for (auto itFuncs = funcs.begin(); itFuncs != funcs.end(); ++itFuncs)
+	{
+		addFunc(itFuncs->first, m_Arena.get(itFuncs->second));
+	}
+}
+
+Program::Program(std::string_view source, FuncRanges_t &&funcs, Imports_t &&imports, bool isFusionEnabled)
+	: m_Imports(std::move(imports))
+	, m_IsLazy(true)
+	, m_IsFusionEnabled(isFusionEnabled)
+	, m_Source(source)
+	, m_FuncRanges(std::move(funcs))
 {}
 
-std::optional<TermHandle_t> Program::load(const std::string &funcName) const
+Program::Program(Image &&image)
+	: m_Image(std::move(image))
+	, m_Imports(m_Image->getImports())
+{
+	const FuncDefs_t &funcs = m_Image->getFuncDefs();
+	for (auto itFuncs = funcs.begin(); itFuncs != funcs.end(); ++itFuncs)
+	{
+		addFunc(itFuncs->first, m_Image->getTerms() + itFuncs->second);
+	}
+}
+
+std::optional<TermHandle_t> Program::load(Var_t funcName) const
 {
+	if (m_IsLazy)
+	{
+		return parseFunc(funcName);
+	}
+
+	// Definitions may be replaced (see 'Reloader') while other machines run
+	std::shared_lock lock(m_FuncsMutex, std::defer_lock);
+	if (m_IsReplaceable)
+	{
+		lock.lock();
+	}
+
 	auto it = m_Funcs.find(funcName);
 	if (it != m_Funcs.end())
 	{
 		return it->second;
 	}
 	return std::nullopt;
+}
+
+const Loop *Program::loadLoop(Var_t funcName) const
+{
+	std::shared_lock lock(m_FuncsMutex, std::defer_lock);
+	if (m_IsLazy || m_IsReplaceable)
+	{
+		lock.lock();
+	}
+
+	auto it = m_Loops.find(funcName);
+	if (it != m_Loops.end())
+	{
+		return &it->second;
+	}
+	return nullptr;
+}
+
+void Program::addHostFunc(std::string_view name, HostFunc &&func)
+{
+	m_HostFuncs.insert_or_assign(internSymbol(name), std::move(func));
+}
+
+const HostFunc *Program::loadHostFunc(Var_t funcName) const
+{
+	if (m_HostFuncs.empty())
+	{
+		return nullptr;
+	}
+
+	auto it = m_HostFuncs.find(funcName);
+	return (it != m_HostFuncs.end()) ? &it->second : nullptr;
+}
+
+const Program::Imports_t &Program::getImports() const
+{
+	return m_Imports;
+}
+
+void Program::link(TermArena &&arena, const FuncDefs_t &funcs)
+{
+	std::lock_guard lock(m_FuncsMutex);
+
+	const TermArena &module = m_ModuleArenas.emplace_back(std::move(arena));
+	for (auto itFuncs = funcs.begin(); itFuncs != funcs.end(); ++itFuncs)
+	{
+		if (!m_Funcs.contains(itFuncs->first))
+		{
+			addFunc(itFuncs->first, module.get(itFuncs->second));
+		}
+	}
+}
+
+void Program::link(Image &&image)
+{
+	std::lock_guard lock(m_FuncsMutex);
+
+	const Image &module = m_ModuleImages.emplace_back(std::move(image));
+	const FuncDefs_t &funcs = module.getFuncDefs();
+	for (auto itFuncs = funcs.begin(); itFuncs != funcs.end(); ++itFuncs)
+	{
+		if (!m_Funcs.contains(itFuncs->first))
+		{
+			addFunc(itFuncs->first, module.getTerms() + itFuncs->second);
+		}
+	}
+}
+
+void Program::allowReplacing()
+{
+	m_IsReplaceable = true;
+}
+
+void Program::replaceAll(std::vector<Replacement> &&replacements, const std::vector<Var_t> &removed)
+{
+	std::lock_guard lock(m_FuncsMutex);
+
+	for (Var_t funcName : removed)
+	{
+		m_Funcs.erase(funcName);
+
+		if (auto node = m_Loops.extract(funcName))
+		{
+			m_ReplacedLoops.push_back(std::move(node));
+		}
+	}
+
+	for (Replacement &replacement : replacements)
+	{
+		const TermArena &replaced = m_ReplacedArenas.emplace_back(std::move(replacement.Arena));
+
+		m_Funcs.erase(replacement.FuncName);
+		addFunc(replacement.FuncName, replaced.get(replacement.FuncIdx));
+	}
+}
+
+bool Program::compile(const std::string &path, uint64_t sourceHash) const
+{
+	if (m_IsLazy)
+	{
+		return false;
+	}
+
+	std::shared_lock lock(m_FuncsMutex);
+
+	const Term *terms = m_Image ? m_Image->getTerms() : m_Arena.get(k_NilTermIdx);
+	size_t numTerms = m_Image ? m_Image->getNumTerms() : m_Arena.size();
+
+	// Linked modules aren't part of the image, they're linked again when it's loaded
+	FuncDefs_t funcs;
+	for (auto itFuncs = m_Funcs.begin(); itFuncs != m_Funcs.end(); ++itFuncs)
+	{
+		if (itFuncs->second >= terms && itFuncs->second < terms + numTerms)
+		{
+			funcs[itFuncs->first] = static_cast<TermIdx_t>(itFuncs->second - terms);
+		}
+	}
+
+	return Image::write(path, sourceHash, terms, numTerms, funcs, m_Imports);
+}
+
+std::string Program::getTermsDebug() const
+{
+	std::lock_guard lock(m_FuncsMutex);
+
+	// The arenas' shared 'NilTerm's aren't counted
+	size_t numParsed = m_Image ? m_Image->getNumTerms() - 1 : m_Arena.getNumAdded();
+	size_t numStored = m_Image ? m_Image->getNumTerms() - 1 : m_Arena.size() - 1;
+
+	for (const TermArena &arena : m_LazyArenas)
+	{
+		numParsed += arena.getNumAdded();
+		numStored += arena.size() - 1;
+	}
+
+	for (const TermArena &arena : m_ModuleArenas)
+	{
+		numParsed += arena.getNumAdded();
+		numStored += arena.size() - 1;
+	}
+
+	for (const Image &image : m_ModuleImages)
+	{
+		numParsed += image.getNumTerms() - 1;
+		numStored += image.getNumTerms() - 1;
+	}
+
+	std::stringstream ss;
+
+	ss << "---- Terms ----" << '\n';
+	ss << "  -- Parsed " << numParsed << '\n';
+	ss << "  -- Stored " << numStored << " (" << (numParsed - numStored) << " shared)" << '\n';
+	if (m_IsLazy)
+	{
+		ss << "  -- Loaded " << m_LazyArenas.size() << " of " << m_FuncRanges.size() << " definitions" << '\n';
+	}
+	ss << "---------------";
+
+	return ss.str();
+}
+
+void Program::addFunc(Var_t funcName, TermHandle_t term) const
+{
+	m_Funcs.emplace(funcName, term);
+
+	// Kept as a loop may be running on another machine
+	if (auto node = m_Loops.extract(funcName))
+	{
+		m_ReplacedLoops.push_back(std::move(node));
+	}
+
+	if (auto loopOpt = Loop::compile(funcName, term))
+	{
+		m_Loops.emplace(funcName, std::move(loopOpt.value()));
+	}
+}
+
+std::optional<TermHandle_t> Program::parseFunc(Var_t funcName) const
+{
+	// Definitions are only parsed once, so most calls only look them up
+	{
+		std::shared_lock lock(m_FuncsMutex);
+
+		auto it = m_Funcs.find(funcName);
+		if (it != m_Funcs.end())
+		{
+			return it->second;
+		}
+	}
+
+	std::lock_guard lock(m_FuncsMutex);
+
+	// Parsed by another machine while the lock was released
+	auto it = m_Funcs.find(funcName);
+	if (it != m_Funcs.end())
+	{
+		return it->second;
+	}
+
+	auto itRanges = m_FuncRanges.find(funcName);
+	if (itRanges == m_FuncRanges.end())
+	{
+		return std::nullopt;
+	}
+
+	// Errors in the definition are reported now, rather than when the program was loaded
+	TermArena &arena = m_LazyArenas.emplace_back();
+
+	Parser parser;
+	parser.setFusion(m_IsFusionEnabled);
+
+	FuncDefs_t funcs;
+	auto [begin, end] = itRanges->second;
+	if (auto errorOpt = parser.tryParseFuncDefs(m_Source, begin, end, arena, funcs))
+	{
+		m_LazyArenas.pop_back();
+		throw LoadError{errorOpt.value()};
+	}
+
+	TermHandle_t term = arena.get(funcs.at(funcName));
+	addFunc(funcName, term);
+
+	return term;
 }
\ No newline at end of file
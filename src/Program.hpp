@@ -2,24 +2,123 @@
 
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <optional>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
 
 #include "Term.hpp"
+#include "Loop.hpp"
+#include "Host.hpp"
+#include "Image.hpp"
+
+// Thrown by 'Program::load' when a lazily parsed definition doesn't parse, the
+// report being what the parser would've displayed
+struct LoadError
+{
+	std::string Report;
+};
 
 class Program
 {
 public:
-	using FuncDefs_t = std::unordered_map<std::string, TermOwner_t>;
+	using FuncDefs_t = std::unordered_map<Var_t, TermIdx_t>;
+	using FuncRanges_t = std::unordered_map<Var_t, std::pair<size_t, size_t>>;
+	// Names of the modules imported by the program
+	using Imports_t = std::vector<Symbol_t>;
 
 public:
 	Program() = delete;
 	Program(const Program &program) = delete;
 	Program(Program &&program) = delete;
 
-	Program(FuncDefs_t &&funcs);
+	// 'funcs' are indices of the definitions within 'arena'
+	Program(TermArena &&arena, FuncDefs_t &&funcs, Imports_t &&imports = {});
+
+	// Lazily parsed, 'funcs' are the ranges of the definitions within 'source'
+	// (which must outlive the program), each of which is parsed when first loaded
+	Program(std::string_view source, FuncRanges_t &&funcs, Imports_t &&imports, bool isFusionEnabled);
+
+	// Executed in place from the (mapped) image
+	Program(Image &&image);
+
+	// Throws 'LoadError' if the definition is lazily parsed & has errors
+	std::optional<TermHandle_t> load(Var_t funcName) const;
+
+	// Compiled loop for the function, if it has the shape of one
+	const Loop *loadLoop(Var_t funcName) const;
+
+	// Native function called instead of the definition named 'name', added
+	// before the program is run, see 'HostFunc'
+	void addHostFunc(std::string_view name, HostFunc &&func);
+	const HostFunc *loadHostFunc(Var_t funcName) const;
+
+	const Imports_t &getImports() const;
+
+	// Adds the definitions of an imported module (already named after it, see
+	// 'Parser::parseModule'), which never replace those of the program itself
+	void link(TermArena &&arena, const FuncDefs_t &funcs);
+	void link(Image &&image);
+
+	// Definition replacing (or added to) those of a running program, whose
+	// term is at 'FuncIdx' within 'Arena'
+	struct Replacement
+	{
+		Var_t FuncName;
+		TermArena Arena;
+		TermIdx_t FuncIdx;
+	};
+
+	// Definitions are only looked up under the lock once they may be replaced
+	// (or when lazily parsed), so this is called before any machine runs it
+	void allowReplacing();
 
-	std::optional<TermHandle_t> load(const std::string &funcName) const;
+	// Replaces (or adds) definitions & removes others while the program is
+	// running, all at once so a machine never sees only some of them changed.
+	// Closures of the old definitions stay valid as their terms are kept.
+	void replaceAll(std::vector<Replacement> &&replacements, const std::vector<Var_t> &removed);
+
+	// Writes the program as an image, see 'Image' (lazily parsed programs can't be)
+	bool compile(const std::string &path, uint64_t sourceHash) const;
+
+	// Number of terms parsed & stored (which differ when terms are shared)
+	std::string getTermsDebug() const;
+
+private:
+	void addFunc(Var_t funcName, TermHandle_t term) const;
+	std::optional<TermHandle_t> parseFunc(Var_t funcName) const;
 
 private:
-	FuncDefs_t m_Funcs;
+	TermArena m_Arena;
+	std::optional<Image> m_Image;
+	Imports_t m_Imports;
+
+	// Linked modules, deques so handles stay valid
+	std::deque<TermArena> m_ModuleArenas;
+	std::deque<Image> m_ModuleImages;
+
+	// Definitions replaced while running, see 'Reloader'
+	std::deque<TermArena> m_ReplacedArenas;
+	mutable std::deque<std::unordered_map<Var_t, Loop>::node_type> m_ReplacedLoops;
+
+	// Definitions are only added after construction when lazily parsed
+	mutable std::unordered_map<Var_t, TermHandle_t> m_Funcs;
+	mutable std::unordered_map<Var_t, Loop> m_Loops;
+
+	std::unordered_map<Var_t, HostFunc> m_HostFuncs;
+
+	bool m_IsLazy = false;
+	bool m_IsReplaceable = false;
+	bool m_IsFusionEnabled = true;
+	std::string_view m_Source;
+	FuncRanges_t m_FuncRanges;
+
+	// Each lazily parsed definition has its own arena, so handles stay valid
+	mutable std::deque<TermArena> m_LazyArenas;
+
+	// Held to add (or replace) definitions, & shared to load them, as machines
+	// on other threads (see 'Machine::spawn' & 'BatchRunner') share the program
+	mutable std::shared_mutex m_FuncsMutex;
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "Reloader.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <functional>
+
+#include "Parser.hpp"
+
+static size_t hashFuncDef(std::string_view source, std::pair<size_t, size_t> range)
+{
+	return std::hash<std::string_view>{}(source.substr(range.first, range.second - range.first));
+}
+
+Reloader::Reloader(Program &program, std::string path, std::string_view source, bool isFusionEnabled)
+	: m_Program(program)
+	, m_Path(std::move(path))
+	, m_IsFusionEnabled(isFusionEnabled)
+{
+	m_Program.allowReplacing();
+
+	std::error_code error;
+	m_LastWriteTime = std::filesystem::last_write_time(m_Path, error);
+
+	// The source already parsed, so can't fail
+	Program::FuncRanges_t ranges;
+	Parser().tryScanFuncDefs(source, ranges);
+
+	for (auto itRanges = ranges.begin(); itRanges != ranges.end(); ++itRanges)
+	{
+		m_FuncHashes[itRanges->first] = hashFuncDef(source, itRanges->second);
+	}
+}
+
+void Reloader::poll()
+{
+	std::error_code error;
+	auto lastWriteTime = std::filesystem::last_write_time(m_Path, error);
+
+	// The file may be briefly missing while an editor replaces it
+	if (error || lastWriteTime == m_LastWriteTime)
+	{
+		return;
+	}
+
+	m_LastWriteTime = lastWriteTime;
+
+	// Read rather than mapped, as the file may be rewritten at any time
+	std::ifstream file(m_Path, std::ios::binary);
+	if (!file)
+	{
+		return;
+	}
+
+	std::stringstream ss;
+	ss << file.rdbuf();
+	reload(ss.str());
+}
+
+void Reloader::reload(std::string_view source)
+{
+	Parser parser;
+	parser.setFusion(m_IsFusionEnabled);
+
+	Program::FuncRanges_t ranges;
+	if (auto errorOpt = parser.tryScanFuncDefs(source, ranges))
+	{
+		std::cerr << "[Reload Error] '" << m_Path << "' was not reloaded" << std::endl << errorOpt.value();
+		return;
+	}
+
+	std::vector<Program::Replacement> changed;
+	std::vector<size_t> hashes;
+
+	for (auto itRanges = ranges.begin(); itRanges != ranges.end(); ++itRanges)
+	{
+		size_t hash = hashFuncDef(source, itRanges->second);
+
+		auto itHashes = m_FuncHashes.find(itRanges->first);
+		if (itHashes != m_FuncHashes.end() && itHashes->second == hash)
+		{
+			continue;
+		}
+
+		TermArena arena;
+		Program::FuncDefs_t funcs;
+		auto [begin, end] = itRanges->second;
+		if (auto errorOpt = parser.tryParseFuncDefs(source, begin, end, arena, funcs))
+		{
+			std::cerr << "[Reload Error] '" << m_Path << "' was not reloaded" << std::endl << errorOpt.value();
+			return;
+		}
+
+		TermIdx_t funcIdx = funcs.at(itRanges->first);
+		changed.push_back(Program::Replacement{itRanges->first, std::move(arena), funcIdx});
+		hashes.push_back(hash);
+	}
+
+	// Definitions no longer in the file
+	std::vector<Var_t> removed;
+	for (auto itHashes = m_FuncHashes.begin(); itHashes != m_FuncHashes.end(); ++itHashes)
+	{
+		if (!ranges.contains(itHashes->first))
+		{
+			removed.push_back(itHashes->first);
+		}
+	}
+
+	if (changed.empty() && removed.empty())
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < changed.size(); ++i)
+	{
+		m_FuncHashes[changed[i].FuncName] = hashes[i];
+	}
+	for (Var_t funcName : removed)
+	{
+		m_FuncHashes.erase(funcName);
+	}
+
+	// Every changed definition parsed, so they're all replaced together
+	size_t numChanged = changed.size();
+	m_Program.replaceAll(std::move(changed), removed);
+
+	std::cerr << "[Reload] " << numChanged << " definition(s) of '" << m_Path << "' replaced, "
+		<< removed.size() << " removed" << std::endl;
+}
\ No newline at end of file
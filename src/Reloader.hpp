@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <filesystem>
+
+#include "Config.hpp"
+#include "Program.hpp"
+
+// Watches the source file of a running program, re-parsing the definitions
+// whose text changed and replacing them in the program (between steps of the
+// machine, so the state of its memory is kept).
+//
+// Updates are all or nothing, if any changed definition doesn't parse the
+// error is displayed and the program is left as it was. Definitions removed
+// from the file are removed from the program (along with the changes), while
+// imported modules are kept.
+class Reloader
+{
+public:
+	// 'source' is what the program was parsed from
+	Reloader(Program &program, std::string path, std::string_view source, bool isFusionEnabled);
+
+	// Reloads the program if the file was modified since the last poll
+	void poll();
+
+private:
+	void reload(std::string_view source);
+
+private:
+	Program &m_Program;
+	std::string m_Path;
+	bool m_IsFusionEnabled;
+
+	std::filesystem::file_time_type m_LastWriteTime;
+
+	// Hash of the text of each definition when it was last parsed
+	std::unordered_map<Var_t, size_t> m_FuncHashes;
+};
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "Symbol.hpp"
+
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+
+#include "Config.hpp"
+
+struct SymbolTable
+{
+	SymbolTable()
+	{
+		for (std::string_view id : k_ReservedLocIds)
+		{
+			Names.emplace_back(id);
+			Symbols.emplace(Names.back(), static_cast<Symbol_t>(Names.size() - 1));
+		}
+	}
+
+	std::shared_mutex Mutex;
+	std::deque<std::string> Names; // Deque so the views in 'Symbols' stay valid
+	std::unordered_map<std::string_view, Symbol_t> Symbols;
+};
+
+static SymbolTable &getSymbolTable()
+{
+	static SymbolTable table;
+	return table;
+}
+
+Symbol_t internSymbol(std::string_view name)
+{
+	SymbolTable &table = getSymbolTable();
+
+	{
+		std::shared_lock lock(table.Mutex);
+
+		auto it = table.Symbols.find(name);
+		if (it != table.Symbols.end())
+		{
+			return it->second;
+		}
+	}
+
+	std::unique_lock lock(table.Mutex);
+
+	auto it = table.Symbols.find(name);
+	if (it != table.Symbols.end())
+	{
+		return it->second;
+	}
+
+	table.Names.emplace_back(name);
+	Symbol_t symbol = static_cast<Symbol_t>(table.Names.size() - 1);
+	table.Symbols.emplace(table.Names.back(), symbol);
+
+	return symbol;
+}
+
+const std::string &getSymbolName(Symbol_t symbol)
+{
+	SymbolTable &table = getSymbolTable();
+
+	std::shared_lock lock(table.Mutex);
+	return table.Names[symbol];
+}
+
+size_t getNumSymbols()
+{
+	SymbolTable &table = getSymbolTable();
+
+	std::shared_lock lock(table.Mutex);
+	return table.Names.size();
+}
\ No newline at end of file
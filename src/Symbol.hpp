@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cinttypes>
+
+// Identifiers (variables, locations and function names) are interned, so they
+// can be stored, hashed and compared as small integers.
+using Symbol_t = uint32_t;
+
+constexpr Symbol_t k_NoSymbol = UINT32_MAX;
+
+// The same name always gives the same symbol, this is safe to call from any thread
+Symbol_t internSymbol(std::string_view name);
+const std::string &getSymbolName(Symbol_t symbol);
+
+// Symbols are numbered consecutively from zero, in the order they were interned
+size_t getNumSymbols();
\ No newline at end of file
@@ -1,18 +1,15 @@
 #include "Term.hpp"
 
-TermOwner_t newTerm(Term &&term)
+#include <functional>
+#include <type_traits>
+
+static size_t hashCombine(size_t seed, size_t value)
 {
-	return std::make_shared<Term>(std::move(term));
+	return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
 }
 
 VarTerm::VarTerm(Var_t var)
 	: m_Var(var)
-	, m_Body(newTerm(NilTerm()))
-{}
-
-VarTerm::VarTerm(Var_t var, Term &&body)
-	: m_Var(var)
-	, m_Body(newTerm(std::move(body)))
 {}
 
 Var_t VarTerm::getVar() const
@@ -20,22 +17,9 @@ Var_t VarTerm::getVar() const
 	return m_Var;
 }
 
-TermHandle_t VarTerm::getBody() const
-{
-	return m_Body;
-}
-
 AbsTerm::AbsTerm(Loc_t loc, std::optional<Var_t> var)
 	: m_Loc(loc)
-	, m_Var(var)
-	, m_Body(newTerm(NilTerm()))
-{
-}
-
-AbsTerm::AbsTerm(Loc_t loc, std::optional<Var_t> var, Term &&body)
-	: m_Loc(loc)
-	, m_Var(var)
-	, m_Body(newTerm(std::move(body)))
+	, m_Var(var.value_or(k_NoSymbol))
 {}
 
 Loc_t AbsTerm::getLoc() const
@@ -45,24 +29,15 @@ Loc_t AbsTerm::getLoc() const
 
 std::optional<Var_t> AbsTerm::getVar() const
 {
+	if (m_Var == k_NoSymbol)
+	{
+		return std::nullopt;
+	}
 	return m_Var;
 }
 
-TermHandle_t AbsTerm::getBody() const
-{
-	return m_Body;
-}
-
-AppTerm::AppTerm(const Loc_t &loc, Term &&arg)
-	: m_Loc(loc)
-	, m_Arg(newTerm(std::move(arg)))
-	, m_Body(newTerm(NilTerm()))
-{}
-
-AppTerm::AppTerm(const Loc_t &loc, Term &&arg, Term &&body)
+AppTerm::AppTerm(Loc_t loc)
 	: m_Loc(loc)
-	, m_Arg(newTerm(std::move(arg)))
-	, m_Body(newTerm(std::move(body)))
 {}
 
 Loc_t AppTerm::getLoc() const
@@ -70,34 +45,9 @@ Loc_t AppTerm::getLoc() const
 	return m_Loc;
 }
 
-TermHandle_t AppTerm::getArg() const
-{
-	return m_Arg;
-}
-
-TermHandle_t AppTerm::getBody() const
-{
-	return m_Body;
-}
-
-ValTerm::ValTerm(Prim_t prim)
-	: m_Val(prim)
-{}
-
-ValTerm::ValTerm(Loc_t loc)
-	: m_Val(loc)
-{}
-
 LocAbsTerm::LocAbsTerm(Loc_t loc, std::optional<LocVar_t> var)
 	: m_Loc(loc)
-	, m_LocVar(var)
-	, m_Body(newTerm(NilTerm()))
-{}
-
-LocAbsTerm::LocAbsTerm(Loc_t loc, std::optional<LocVar_t> var, Term &&body)
-	: m_Loc(loc)
-	, m_LocVar(var)
-	, m_Body(newTerm(std::move(body)))
+	, m_LocVar(var.value_or(k_NoSymbol))
 {}
 
 Loc_t LocAbsTerm::getLoc() const
@@ -107,24 +57,16 @@ Loc_t LocAbsTerm::getLoc() const
 
 std::optional<LocVar_t> LocAbsTerm::getLocVar() const
 {
+	if (m_LocVar == k_NoSymbol)
+	{
+		return std::nullopt;
+	}
 	return m_LocVar;
 }
 
-TermHandle_t LocAbsTerm::getBody() const
-{
-	return m_Body;
-}
-
 LocAppTerm::LocAppTerm(Loc_t loc, LocVar_t arg)
 	: m_Loc(loc)
 	, m_Arg(arg)
-	, m_Body(newTerm(NilTerm()))
-{}
-
-LocAppTerm::LocAppTerm(Loc_t loc, LocVar_t arg, Term &&body)
-	: m_Loc(loc)
-	, m_Arg(arg)
-	, m_Body(newTerm(std::move(body)))
 {}
 
 Loc_t LocAppTerm::getLoc() const
@@ -137,10 +79,13 @@ LocVar_t LocAppTerm::getArg() const
 	return m_Arg;
 }
 
-TermHandle_t LocAppTerm::getBody() const
-{
-	return m_Body;
-}
+ValTerm::ValTerm(Prim_t prim)
+	: m_Val(prim)
+{}
+
+ValTerm::ValTerm(Loc_t loc)
+	: m_Val(loc)
+{}
 
 bool ValTerm::isPrim() const
 {
@@ -164,12 +109,6 @@ Loc_t ValTerm::asLoc() const
 
 BinOpTerm::BinOpTerm(BinOpTerm::Op op)
 	: m_Op(op)
-	, m_Body(newTerm(NilTerm()))
-{}
-
-BinOpTerm::BinOpTerm(BinOpTerm::Op op, Term &&body)
-	: m_Op(op)
-	, m_Body(newTerm(std::move(body)))
 {}
 
 bool BinOpTerm::isOp(BinOpTerm::Op op) const
@@ -177,57 +116,82 @@ bool BinOpTerm::isOp(BinOpTerm::Op op) const
 	return m_Op == op;
 }
 
-TermHandle_t BinOpTerm::getBody() const
+template<typename Case_t>
+CasesTerm<Case_t>::CasesTerm(uint32_t numCases)
+	: m_NumCases(numCases)
+{}
+
+template<typename Case_t>
+uint32_t CasesTerm<Case_t>::getNumCases() const
 {
-	return m_Body;
+	return m_NumCases;
 }
 
-template<typename Case_t>
-CasesTerm<Case_t>::CasesTerm(CasesTerm<Case_t>::Cases_t &&cases, TermOwner_t &&otherwise, Term &&body)
-	: m_Cases(std::move(cases))
-	, m_OtherwiseCase(std::move(otherwise))
-	, m_Body(newTerm(std::move(body)))
+template class CasesTerm<Prim_t>;
+template class CasesTerm<Loc_t>;
+
+BinOpVarsTerm::BinOpVarsTerm(Var_t lhs, Var_t rhs, BinOpTerm::Op op)
+	: m_Lhs(lhs)
+	, m_Rhs(rhs)
+	, m_Op(op)
 {}
 
-template<typename Case_t>
-CasesTerm<Case_t>::CasesTerm(CasesTerm<Case_t>::Cases_t &&cases, TermOwner_t &&otherwise)
-	: m_Cases(std::move(cases))
-	, m_OtherwiseCase(std::move(otherwise))
-	, m_Body(newTerm(NilTerm()))
+Var_t BinOpVarsTerm::getLhs() const
+{
+	return m_Lhs;
+}
+
+Var_t BinOpVarsTerm::getRhs() const
+{
+	return m_Rhs;
+}
+
+bool BinOpVarsTerm::isOp(BinOpTerm::Op op) const
+{
+	return m_Op == op;
+}
+
+PeekPairTerm::PeekPairTerm(Loc_t loc, Var_t var, LocVar_t locVar)
+	: m_Loc(loc)
+	, m_Var(var)
+	, m_LocVar(locVar)
 {}
 
-template<typename Case_t>
-TermHandle_t CasesTerm<Case_t>::getOtherwise() const
+Loc_t PeekPairTerm::getLoc() const
 {
-	return m_OtherwiseCase;
+	return m_Loc;
 }
 
-template<typename Case_t>
-typename CasesTerm<Case_t>::Cases_t::const_iterator CasesTerm<Case_t>::find(const Case_t &c) const
+Var_t PeekPairTerm::getVar() const
 {
-	return m_Cases.find(c);
+	return m_Var;
 }
 
-template<typename Case_t>
-typename CasesTerm<Case_t>::Cases_t::const_iterator CasesTerm<Case_t>::begin() const
+LocVar_t PeekPairTerm::getLocVar() const
 {
-	return m_Cases.begin();
+	return m_LocVar;
 }
 
-template<typename Case_t>
-typename CasesTerm<Case_t>::Cases_t::const_iterator CasesTerm<Case_t>::end() const
+MoveTerm::MoveTerm(Loc_t srcLoc, Var_t var, Loc_t dstLoc)
+	: m_SrcLoc(srcLoc)
+	, m_Var(var)
+	, m_DstLoc(dstLoc)
+{}
+
+Loc_t MoveTerm::getSrcLoc() const
 {
-	return m_Cases.end();
+	return m_SrcLoc;
 }
 
-template<typename Case_t>
-TermHandle_t CasesTerm<Case_t>::getBody() const
+Var_t MoveTerm::getVar() const
 {
-	return m_Body;
+	return m_Var;
 }
 
-template class CasesTerm<Prim_t>;
-template class CasesTerm<Loc_t>;
+Loc_t MoveTerm::getDstLoc() const
+{
+	return m_DstLoc;
+}
 
 Term::Term()
 	: m_Term(NilTerm())
@@ -273,6 +237,18 @@ Term::Term(CasesTerm<Loc_t> &&term)
 	: m_Term(std::move(term))
 {}
 
+Term::Term(BinOpVarsTerm &&term)
+	: m_Term(std::move(term))
+{}
+
+Term::Term(PeekPairTerm &&term)
+	: m_Term(std::move(term))
+{}
+
+Term::Term(MoveTerm &&term)
+	: m_Term(std::move(term))
+{}
+
 bool Term::isNil() const
 {
 	return std::holds_alternative<NilTerm>(m_Term);
@@ -323,6 +299,181 @@ bool Term::isLocCases() const
 	return std::holds_alternative<CasesTerm<Loc_t>>(m_Term);
 }
 
+bool Term::isBinOpVars() const
+{
+	return std::holds_alternative<BinOpVarsTerm>(m_Term);
+}
+
+bool Term::isPeekPair() const
+{
+	return std::holds_alternative<PeekPairTerm>(m_Term);
+}
+
+bool Term::isMove() const
+{
+	return std::holds_alternative<MoveTerm>(m_Term);
+}
+
+size_t Term::getKindIndex() const
+{
+	return m_Term.index();
+}
+
+TermHandle_t Term::follow(TermLink_t link) const
+{
+	return (link != 0) ? this + link : nullptr;
+}
+
+size_t Term::getHash(TermIdx_t idx) const
+{
+	size_t payloadHash = std::visit([](const auto &term) -> size_t {
+		using T = std::decay_t<decltype(term)>;
+
+		if      constexpr (std::is_same_v<T, VarTerm>)    { return term.getVar(); }
+		else if constexpr (std::is_same_v<T, AbsTerm>)    { return hashCombine(term.getLoc(), term.getVar().value_or(k_NoSymbol)); }
+		else if constexpr (std::is_same_v<T, AppTerm>)    { return term.getLoc(); }
+		else if constexpr (std::is_same_v<T, LocAbsTerm>) { return hashCombine(term.getLoc(), term.getLocVar().value_or(k_NoSymbol)); }
+		else if constexpr (std::is_same_v<T, LocAppTerm>) { return hashCombine(term.getLoc(), term.getArg()); }
+		else if constexpr (std::is_same_v<T, ValTerm>)    { return term.isPrim() ? std::hash<Prim_t>{}(term.asPrim()) : hashCombine(1, term.asLoc()); }
+		else if constexpr (std::is_same_v<T, BinOpTerm>)  { return term.isOp(BinOpTerm::Plus); }
+		else if constexpr (std::is_same_v<T, CasesTerm<Prim_t>> || std::is_same_v<T, CasesTerm<Loc_t>>)
+		{
+			return term.getNumCases();
+		}
+		else if constexpr (std::is_same_v<T, BinOpVarsTerm>)
+		{
+			return hashCombine(hashCombine(term.getLhs(), term.getRhs()), term.isOp(BinOpTerm::Plus));
+		}
+		else if constexpr (std::is_same_v<T, PeekPairTerm>)
+		{
+			return hashCombine(hashCombine(term.getLoc(), term.getVar()), term.getLocVar());
+		}
+		else if constexpr (std::is_same_v<T, MoveTerm>)
+		{
+			return hashCombine(hashCombine(term.getSrcLoc(), term.getVar()), term.getDstLoc());
+		}
+		else
+		{
+			return 0;
+		}
+	}, m_Term);
+
+	size_t hash = hashCombine(m_Term.index(), payloadHash);
+	hash = hashCombine(hash, m_Body ? idx + m_Body : k_NoTermIdx);
+	hash = hashCombine(hash, m_Arg ? idx + m_Arg : k_NoTermIdx);
+	hash = hashCombine(hash, m_Cases ? idx + m_Cases : k_NoTermIdx);
+	return hash;
+}
+
+bool Term::isSame(TermIdx_t idx, const Term &other, TermIdx_t otherIdx) const
+{
+	auto isSameLink = [&](TermLink_t link, TermLink_t otherLink) {
+		return (link != 0 && otherLink != 0)
+			? static_cast<int64_t>(idx) + link == static_cast<int64_t>(otherIdx) + otherLink
+			: link == otherLink;
+	};
+
+	return m_Term == other.m_Term &&
+		isSameLink(m_Body, other.m_Body) &&
+		isSameLink(m_Arg, other.m_Arg) &&
+		isSameLink(m_Cases, other.m_Cases);
+}
+
+void Term::remapSymbols(const std::vector<Symbol_t> &symbols)
+{
+	auto remap = [&](Symbol_t symbol) {
+		return (symbol < symbols.size()) ? symbols[symbol] : symbol;
+	};
+	auto remapOpt = [&](auto symbolOpt) -> std::optional<Symbol_t> {
+		return symbolOpt ? std::optional(remap(symbolOpt.value())) : std::nullopt;
+	};
+
+	m_Term = std::visit([&](const auto &term) -> Variant_t {
+		using T = std::decay_t<decltype(term)>;
+
+		if      constexpr (std::is_same_v<T, VarTerm>)    { return VarTerm(remap(term.getVar())); }
+		else if constexpr (std::is_same_v<T, AbsTerm>)    { return AbsTerm(remap(term.getLoc()), remapOpt(term.getVar())); }
+		else if constexpr (std::is_same_v<T, AppTerm>)    { return AppTerm(remap(term.getLoc())); }
+		else if constexpr (std::is_same_v<T, LocAbsTerm>) { return LocAbsTerm(remap(term.getLoc()), remapOpt(term.getLocVar())); }
+		else if constexpr (std::is_same_v<T, LocAppTerm>) { return LocAppTerm(remap(term.getLoc()), remap(term.getArg())); }
+		else if constexpr (std::is_same_v<T, ValTerm>)    { return term.isPrim() ? term : ValTerm(remap(term.asLoc())); }
+		else if constexpr (std::is_same_v<T, BinOpVarsTerm>)
+		{
+			return BinOpVarsTerm(remap(term.getLhs()), remap(term.getRhs()),
+				term.isOp(BinOpTerm::Plus) ? BinOpTerm::Plus : BinOpTerm::Minus);
+		}
+		else if constexpr (std::is_same_v<T, PeekPairTerm>)
+		{
+			return PeekPairTerm(remap(term.getLoc()), remap(term.getVar()), remap(term.getLocVar()));
+		}
+		else if constexpr (std::is_same_v<T, MoveTerm>)
+		{
+			return MoveTerm(remap(term.getSrcLoc()), remap(term.getVar()), remap(term.getDstLoc()));
+		}
+		else
+		{
+			return term;
+		}
+	}, m_Term);
+}
+
+TermHandle_t Term::getBody() const
+{
+	return follow(m_Body);
+}
+
+TermHandle_t Term::getArg() const
+{
+	return follow(m_Arg);
+}
+
+TermHandle_t Term::getOtherwise() const
+{
+	return follow(m_Arg);
+}
+
+TermHandle_t Term::getOriginal() const
+{
+	return follow(m_Arg);
+}
+
+TermHandle_t Term::getCase(uint32_t i) const
+{
+	return follow(m_Cases) + i;
+}
+
+TermHandle_t Term::findPrimCase(Prim_t prim) const
+{
+	TermHandle_t cases = follow(m_Cases);
+	uint32_t numCases = asPrimCases().getNumCases();
+
+	for (uint32_t i = 0; i < numCases; ++i)
+	{
+		if (cases[i].asVal().asPrim() == prim)
+		{
+			return cases[i].getArg();
+		}
+	}
+
+	return nullptr;
+}
+
+TermHandle_t Term::findLocCase(Loc_t loc) const
+{
+	TermHandle_t cases = follow(m_Cases);
+	uint32_t numCases = asLocCases().getNumCases();
+
+	for (uint32_t i = 0; i < numCases; ++i)
+	{
+		if (cases[i].asVal().asLoc() == loc)
+		{
+			return cases[i].getArg();
+		}
+	}
+
+	return nullptr;
+}
+
 const NilTerm &Term::asNil() const
 {
 	return std::get<NilTerm>(m_Term);
@@ -371,4 +522,188 @@ const CasesTerm<Prim_t> &Term::asPrimCases() const
 const CasesTerm<Loc_t> &Term::asLocCases() const
 {
 	return std::get<CasesTerm<Loc_t>>(m_Term);
+}
+
+const BinOpVarsTerm &Term::asBinOpVars() const
+{
+	return std::get<BinOpVarsTerm>(m_Term);
+}
+
+const PeekPairTerm &Term::asPeekPair() const
+{
+	return std::get<PeekPairTerm>(m_Term);
+}
+
+const MoveTerm &Term::asMove() const
+{
+	return std::get<MoveTerm>(m_Term);
+}
+
+TermArena::TermArena()
+	: m_SharedRuns(makeSharedRuns())
+{
+	m_Terms.push_back(Term(NilTerm()));
+}
+
+TermArena::TermArena(TermArena &&arena)
+	: m_Terms(std::move(arena.m_Terms))
+	, m_IsSharing(arena.m_IsSharing)
+	, m_NumAdded(arena.m_NumAdded)
+	, m_SharedRuns(makeSharedRuns())
+{}
+
+TermArena &TermArena::operator=(TermArena &&arena)
+{
+	m_Terms = std::move(arena.m_Terms);
+	m_IsSharing = arena.m_IsSharing;
+	m_NumAdded = arena.m_NumAdded;
+	m_SharedRuns = makeSharedRuns();
+	return *this;
+}
+
+void TermArena::setSharing(bool isEnabled)
+{
+	m_IsSharing = isEnabled;
+}
+
+TermLink_t TermArena::toLink(TermIdx_t idx, TermIdx_t target)
+{
+	return (target != k_NoTermIdx) ? static_cast<TermLink_t>(
+		static_cast<int64_t>(target) - static_cast<int64_t>(idx)
+	) : 0;
+}
+
+TermIdx_t TermArena::add(Term &&term, TermIdx_t body, TermIdx_t arg, TermIdx_t cases)
+{
+	TermIdx_t idx = static_cast<TermIdx_t>(m_Terms.size());
+
+	// Nil & values have no continuation
+	if (term.isNil() || term.isVal())
+	{
+		body = (body == k_NilTermIdx) ? k_NoTermIdx : body;
+	}
+
+	term.m_Body = toLink(idx, body);
+	term.m_Arg = toLink(idx, arg);
+	term.m_Cases = toLink(idx, cases);
+
+	m_Terms.push_back(std::move(term));
+	m_NumAdded++;
+
+	return share(idx, 1);
+}
+
+TermIdx_t TermArena::addCases(std::vector<std::pair<ValTerm, TermIdx_t>> &&cases)
+{
+	TermIdx_t first = static_cast<TermIdx_t>(m_Terms.size());
+
+	for (auto &c : cases)
+	{
+		TermIdx_t idx = static_cast<TermIdx_t>(m_Terms.size());
+
+		Term term(std::move(c.first));
+		term.m_Arg = toLink(idx, c.second);
+
+		m_Terms.push_back(std::move(term));
+		m_NumAdded++;
+	}
+
+	return share(first, static_cast<uint32_t>(cases.size()));
+}
+
+TermIdx_t TermArena::share(TermIdx_t first, uint32_t count)
+{
+	if (!m_IsSharing || count == 0)
+	{
+		return first;
+	}
+
+	auto [itRun, isInserted] = m_SharedRuns.insert({first, count});
+	if (!isInserted)
+	{
+		// Drop the duplicate, which was just added to the end
+		m_Terms.resize(first);
+		return itRun->First;
+	}
+
+	return first;
+}
+
+TermArena::SharedRuns_t TermArena::makeSharedRuns()
+{
+	return SharedRuns_t(0, RunHash{&m_Terms}, RunEqual{&m_Terms});
+}
+
+size_t TermArena::RunHash::operator()(const Run &run) const
+{
+	size_t hash = run.Count;
+	for (uint32_t i = 0; i < run.Count; ++i)
+	{
+		hash = hashCombine(hash, (*Terms)[run.First + i].getHash(run.First + i));
+	}
+	return hash;
+}
+
+bool TermArena::RunEqual::operator()(const Run &lhs, const Run &rhs) const
+{
+	if (lhs.Count != rhs.Count)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < lhs.Count; ++i)
+	{
+		const Term &lhsTerm = (*Terms)[lhs.First + i];
+		const Term &rhsTerm = (*Terms)[rhs.First + i];
+
+		if (!lhsTerm.isSame(lhs.First + i, rhsTerm, rhs.First + i))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+TermHandle_t TermArena::get(TermIdx_t idx) const
+{
+	return &m_Terms[idx];
+}
+
+TermIdx_t TermArena::getIdx(TermHandle_t term) const
+{
+	return static_cast<TermIdx_t>(term - m_Terms.data());
+}
+
+size_t TermArena::size() const
+{
+	return m_Terms.size();
+}
+
+void TermArena::reserve(size_t size)
+{
+	m_Terms.reserve(size);
+}
+
+TermIdx_t TermArena::append(TermArena &&arena)
+{
+	TermIdx_t offset = static_cast<TermIdx_t>(m_Terms.size());
+
+	// Links are relative, so the terms can be moved as they are
+	m_Terms.insert(m_Terms.end(),
+		std::make_move_iterator(arena.m_Terms.begin()),
+		std::make_move_iterator(arena.m_Terms.end())
+	);
+	// Its 'NilTerm' comes along too, so is counted as added
+	m_NumAdded += arena.m_NumAdded + 1;
+
+	arena.m_Terms.clear();
+	arena.m_NumAdded = 0;
+
+	return offset;
+}
+
+size_t TermArena::getNumAdded() const
+{
+	return m_NumAdded;
 }
\ No newline at end of file
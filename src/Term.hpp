@@ -1,182 +1,139 @@
 #pragma once
 
-#include <memory>
 #include <optional>
 #include <variant>
-#include <string>
-#include <map>
+#include <vector>
+#include <unordered_set>
+#include <cinttypes>
 
 #include "Config.hpp"
 
 class Term;
+class TermArena;
 
-using TermOwner_t  = std::shared_ptr<Term>;
-using TermHandle_t = std::shared_ptr<const Term>;
+// Terms are owned by the arena they were built in, and are only ever
+// referred to by (non-owning) handles.
+using TermHandle_t = const Term *;
 
-TermOwner_t newTerm(Term &&term);
+// Index of a term within its arena
+using TermIdx_t = uint32_t;
+
+constexpr TermIdx_t k_NilTermIdx = 0;
+constexpr TermIdx_t k_NoTermIdx  = UINT32_MAX;
+
+// Terms link to each other by offset (relative to the term holding the link),
+// so an arena can be moved or copied as a single block. '0' is no link.
+using TermLink_t = int32_t;
 
 class NilTerm
 {
+public:
+	bool operator==(const NilTerm &term) const = default;
 };
 
 class VarTerm
 {
 public:
-	VarTerm(const VarTerm &term) = delete;
-	VarTerm(VarTerm &&term) = default;
-
 	VarTerm(Var_t var);
-	VarTerm(Var_t var, Term &&body);
-
-	VarTerm &operator=(const VarTerm &term) = delete;
-	VarTerm &operator=(VarTerm &&term) = delete;
 
 	Var_t getVar() const;
-	TermHandle_t getBody() const;
+
+	bool operator==(const VarTerm &term) const = default;
 
 private:
 	Var_t m_Var;
-	TermOwner_t m_Body;
 };
 
 class AbsTerm
 {
 public:
-	AbsTerm(const AbsTerm &term) = delete;
-	AbsTerm(AbsTerm &&term) = default;
-
 	AbsTerm(Loc_t loc, std::optional<Var_t> var);
-	AbsTerm(Loc_t loc, std::optional<Var_t> var, Term &&body);
-
-	AbsTerm &operator=(const AbsTerm &term) = delete;
-	AbsTerm &operator=(AbsTerm &&term) = delete;
 
 	Loc_t getLoc() const;
 	std::optional<Var_t> getVar() const;
-	TermHandle_t getBody() const;
+
+	bool operator==(const AbsTerm &term) const = default;
 
 private:
 	Loc_t m_Loc;
-	std::optional<Var_t> m_Var;
-	TermOwner_t m_Body;
+	Var_t m_Var;
 };
 
 class AppTerm
 {
 public:
-	AppTerm(const AppTerm &term) = delete;
-	AppTerm(AppTerm &&term) = default;
-
-	AppTerm(const Loc_t &loc, Term &&arg);
-	AppTerm(const Loc_t &loc, Term &&arg, Term &&body);
-
-	AppTerm &operator=(const AppTerm &term) = delete;
-	AppTerm &operator=(AppTerm &&term) = delete;
+	AppTerm(Loc_t loc);
 
 	Loc_t getLoc() const;
-	TermHandle_t getArg() const;
-	TermHandle_t getBody() const;
+
+	bool operator==(const AppTerm &term) const = default;
 
 private:
 	Loc_t m_Loc;
-	TermOwner_t m_Arg;
-	TermOwner_t m_Body;
 };
 
 class LocAbsTerm
 {
 public:
-	LocAbsTerm(const LocAbsTerm &term) = delete;
-	LocAbsTerm(LocAbsTerm &&term) = default;
-
 	LocAbsTerm(Loc_t loc, std::optional<LocVar_t> var);
-	LocAbsTerm(Loc_t loc, std::optional<LocVar_t> var, Term &&body);
-
-	LocAbsTerm &operator=(const LocAbsTerm &term) = delete;
-	LocAbsTerm &operator=(LocAbsTerm &&term) = delete;
 
 	Loc_t getLoc() const;
 	std::optional<LocVar_t> getLocVar() const;
-	TermHandle_t getBody() const;
+
+	bool operator==(const LocAbsTerm &term) const = default;
 
 private:
 	Loc_t m_Loc;
-	std::optional<LocVar_t> m_LocVar;
-	TermOwner_t m_Body;
+	LocVar_t m_LocVar;
 };
 
 class LocAppTerm
 {
 public:
-	LocAppTerm(const LocAppTerm &term) = delete;
-	LocAppTerm(LocAppTerm &&term) = default;
-
 	LocAppTerm(Loc_t loc, LocVar_t arg);
-	LocAppTerm(Loc_t loc, LocVar_t arg, Term &&body);
-
-	LocAppTerm &operator=(const LocAppTerm &term) = delete;
-	LocAppTerm &operator=(LocAppTerm &&term) = delete;
 
 	Loc_t getLoc() const;
 	LocVar_t getArg() const;
-	TermHandle_t getBody() const;
+
+	bool operator==(const LocAppTerm &term) const = default;
 
 private:
 	Loc_t m_Loc;
 	LocVar_t m_Arg;
-	TermOwner_t m_Body;
 };
 
 class ValTerm
 {
 public:
-	ValTerm(const ValTerm &term) = delete;
-	ValTerm(ValTerm &&term) = default;
-
 	ValTerm(Prim_t prim);
 	ValTerm(Loc_t loc);
 
-	ValTerm &operator=(const ValTerm &term) = delete;
-	ValTerm &operator=(ValTerm &&term) = delete;
-
 	bool isPrim() const;
 	bool isLoc() const;
 
 	Prim_t asPrim() const;
 	Loc_t asLoc() const;
 
+	bool operator==(const ValTerm &term) const = default;
+
 private:
 	std::variant<Prim_t, Loc_t> m_Val;
 };
 
+// Each case is a value term (of the matched value) stored consecutively in
+// the arena, whose argument is the term for that case.
 template<typename Case_t>
 class CasesTerm
 {
 public:
-	using Cases_t = std::map<Case_t, TermOwner_t>;
-
-public:
-	CasesTerm(const CasesTerm &term) = delete;
-	CasesTerm(CasesTerm &&term) = default;
+	CasesTerm(uint32_t numCases);
 
-	CasesTerm(Cases_t &&cases, TermOwner_t &&otherwise, Term &&body);
-	CasesTerm(Cases_t &&cases, TermOwner_t &&otherwise);
+	uint32_t getNumCases() const;
 
-	CasesTerm &operator=(const CasesTerm &term) = delete;
-	CasesTerm &operator=(CasesTerm &&term) = delete;
-
-	TermHandle_t getOtherwise() const;
-
-	typename Cases_t::const_iterator find(const Case_t &c) const;
-	typename Cases_t::const_iterator begin() const;
-	typename Cases_t::const_iterator end() const;
-
-	TermHandle_t getBody() const;
+	bool operator==(const CasesTerm &term) const = default;
 
 private:
-	Cases_t m_Cases;
-	TermOwner_t m_OtherwiseCase;
-	TermOwner_t m_Body;
+	uint32_t m_NumCases;
 };
 
 class BinOpTerm
@@ -187,26 +144,86 @@ public:
 		Plus, Minus
 	};
 public:
-	BinOpTerm(const BinOpTerm &term) = delete;
-	BinOpTerm(BinOpTerm &&term) = default;
-
 	BinOpTerm(Op op);
-	BinOpTerm(Op op, Term &&body);
-
-	BinOpTerm &operator=(const BinOpTerm &term) = delete;
-	BinOpTerm &operator=(BinOpTerm &&term) = delete;
 
 	bool isOp(Op op) const;
 
-	TermHandle_t getBody() const;
+	bool operator==(const BinOpTerm &term) const = default;
 
 private:
 	Op m_Op;
-	TermOwner_t m_Body;
+};
+
+// Superinstructions are fused sequences of terms which the parser recognises
+// at load time. Each one keeps the original (unfused) sequence, which is both
+// used for printing and executed instead whenever the fast path can't apply.
+
+// [x] . [y] . op
+class BinOpVarsTerm
+{
+public:
+	BinOpVarsTerm(Var_t lhs, Var_t rhs, BinOpTerm::Op op);
+
+	Var_t getLhs() const;
+	Var_t getRhs() const;
+	bool isOp(BinOpTerm::Op op) const;
+
+	bool operator==(const BinOpVarsTerm &term) const = default;
+
+private:
+	Var_t m_Lhs;
+	Var_t m_Rhs;
+	BinOpTerm::Op m_Op;
+};
+
+// l<x> . l<@y> . [#y]l . [x]l
+class PeekPairTerm
+{
+public:
+	PeekPairTerm(Loc_t loc, Var_t var, LocVar_t locVar);
+
+	Loc_t getLoc() const;
+	Var_t getVar() const;
+	LocVar_t getLocVar() const;
+
+	bool operator==(const PeekPairTerm &term) const = default;
+
+private:
+	Loc_t m_Loc;
+	Var_t m_Var;
+	LocVar_t m_LocVar;
+};
+
+// l<x> . [x]k
+class MoveTerm
+{
+public:
+	MoveTerm(Loc_t srcLoc, Var_t var, Loc_t dstLoc);
+
+	Loc_t getSrcLoc() const;
+	Var_t getVar() const;
+	Loc_t getDstLoc() const;
+
+	bool operator==(const MoveTerm &term) const = default;
+
+private:
+	Loc_t m_SrcLoc;
+	Var_t m_Var;
+	Loc_t m_DstLoc;
 };
 
 class Term
 {
+private:
+	using Variant_t = std::variant<
+		NilTerm, VarTerm, AbsTerm, AppTerm, LocAbsTerm, LocAppTerm, /* FCL-FMC           */
+		ValTerm, BinOpTerm, CasesTerm<Prim_t>, CasesTerm<Loc_t>,    /* Extensions        */
+		BinOpVarsTerm, PeekPairTerm, MoveTerm                       /* Superinstructions */
+	>;
+
+public:
+	static constexpr size_t s_NumKinds = std::variant_size_v<Variant_t>;
+
 public:
 	Term();
 	Term(const Term &term) = delete;
@@ -224,8 +241,12 @@ public:
 	Term(CasesTerm<Prim_t> &&term);
 	Term(CasesTerm<Loc_t> &&term);
 
+	Term(BinOpVarsTerm &&term);
+	Term(PeekPairTerm &&term);
+	Term(MoveTerm &&term);
+
 	Term &operator=(const Term &term) = delete;
-	Term &operator=(Term &&term) = delete;
+	Term &operator=(Term &&term) = default;
 
 	bool isNil() const;
 	bool isVar() const;
@@ -239,21 +260,139 @@ public:
 	bool isPrimCases() const;
 	bool isLocCases() const;
 
+	bool isBinOpVars() const;
+	bool isPeekPair() const;
+	bool isMove() const;
+
+	size_t getKindIndex() const;
+
+	// Continuation of any kind of term, nullptr for 'NilTerm' and 'ValTerm'
+	TermHandle_t getBody() const;
+	// Argument of 'AppTerm' (or the term of a case)
+	TermHandle_t getArg() const;
+	// 'otherwise' case of cases
+	TermHandle_t getOtherwise() const;
+	// Original sequence of a superinstruction
+	TermHandle_t getOriginal() const;
+
+	// The 'i'th case of cases, a value term whose argument is the term for the case
+	TermHandle_t getCase(uint32_t i) const;
+	// Term for the matching case of cases, nullptr if 'otherwise'
+	TermHandle_t findPrimCase(Prim_t prim) const;
+	TermHandle_t findLocCase(Loc_t loc) const;
+
 	const NilTerm &asNil() const;
 	const VarTerm &asVar() const;
 	const AbsTerm &asAbs() const;
 	const AppTerm &asApp() const;
 	const LocAbsTerm &asLocAbs() const;
 	const LocAppTerm &asLocApp() const;
-	
+
 	const ValTerm &asVal() const;
 	const BinOpTerm &asBinOp() const;
 	const CasesTerm<Prim_t> &asPrimCases() const;
 	const CasesTerm<Loc_t> &asLocCases() const;
 
+	const BinOpVarsTerm &asBinOpVars() const;
+	const PeekPairTerm &asPeekPair() const;
+	const MoveTerm &asMove() const;
+
+	// Replaces each symbol (identifier) with 'symbols[symbol]', for terms which
+	// were parsed when identifiers were interned as different symbols
+	void remapSymbols(const std::vector<Symbol_t> &symbols);
+
+private:
+	friend class TermArena;
+
+	TermHandle_t follow(TermLink_t link) const;
+
+	// Structural hash & equality of terms at 'idx' (and 'otherIdx'), following
+	// links by index so the same structure hashes the same at any position
+	size_t getHash(TermIdx_t idx) const;
+	bool isSame(TermIdx_t idx, const Term &other, TermIdx_t otherIdx) const;
+
 private:
-	std::variant<
-		NilTerm, VarTerm, AbsTerm, AppTerm, LocAbsTerm, LocAppTerm, /* FCL-FMC    */
-		ValTerm, BinOpTerm, CasesTerm<Prim_t>, CasesTerm<Loc_t>     /* Extensions */ 
-	> m_Term;
+	Variant_t m_Term;
+
+	TermLink_t m_Body = 0;
+	TermLink_t m_Arg = 0;
+	TermLink_t m_Cases = 0;
+};
+
+// Contiguous storage for terms, the first of which is always a 'NilTerm'
+// shared by every term without a body.
+//
+// With sharing enabled the arena is hash-consed: adding a term (or run of
+// cases) which is structurally identical to one already added returns the
+// existing one instead. Sharing only applies to terms added since the arena
+// was created or last moved.
+class TermArena
+{
+public:
+	TermArena();
+	TermArena(const TermArena &arena) = delete;
+	TermArena(TermArena &&arena);
+
+	TermArena &operator=(const TermArena &arena) = delete;
+	TermArena &operator=(TermArena &&arena);
+
+	void setSharing(bool isEnabled);
+
+	// 'arg' is the argument of an application, the 'otherwise' case of cases
+	// or the original sequence of a superinstruction. 'cases' is the first of
+	// the consecutive cases of cases.
+	TermIdx_t add(Term &&term, TermIdx_t body = k_NilTermIdx,
+		TermIdx_t arg = k_NoTermIdx, TermIdx_t cases = k_NoTermIdx);
+
+	// Adds the cases of cases consecutively, each being a value & the index of
+	// the term for it, and returns the index of the first
+	TermIdx_t addCases(std::vector<std::pair<ValTerm, TermIdx_t>> &&cases);
+
+	// Handles are invalidated when terms are added
+	TermHandle_t get(TermIdx_t idx) const;
+	TermIdx_t getIdx(TermHandle_t term) const;
+
+	size_t size() const;
+	void reserve(size_t size);
+
+	// Moves the terms of 'arena' to the end of this one, returning the offset
+	// to add to their indices
+	TermIdx_t append(TermArena &&arena);
+
+	// Number of terms added, including those which were shared
+	size_t getNumAdded() const;
+
+private:
+	// A run of consecutive terms, single terms being runs of one
+	struct Run
+	{
+		TermIdx_t First;
+		uint32_t Count;
+	};
+
+	struct RunHash
+	{
+		const std::vector<Term> *Terms;
+		size_t operator()(const Run &run) const;
+	};
+
+	struct RunEqual
+	{
+		const std::vector<Term> *Terms;
+		bool operator()(const Run &lhs, const Run &rhs) const;
+	};
+
+	using SharedRuns_t = std::unordered_set<Run, RunHash, RunEqual>;
+
+	SharedRuns_t makeSharedRuns();
+	TermIdx_t share(TermIdx_t first, uint32_t count);
+
+	static TermLink_t toLink(TermIdx_t idx, TermIdx_t target);
+
+private:
+	std::vector<Term> m_Terms;
+
+	bool m_IsSharing = false;
+	size_t m_NumAdded = 0;
+	SharedRuns_t m_SharedRuns;
 };
\ No newline at end of file
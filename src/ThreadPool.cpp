@@ -0,0 +1,92 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t numThreads)
+{
+	numThreads = std::max<size_t>(numThreads, 1);
+
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_Threads.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_Mutex);
+		m_IsStopping = true;
+	}
+
+	m_TaskCondition.notify_all();
+
+	for (std::thread &thread : m_Threads)
+	{
+		thread.join();
+	}
+}
+
+size_t ThreadPool::getNumThreads() const
+{
+	return m_Threads.size();
+}
+
+void ThreadPool::push(std::function<void()> &&task)
+{
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Tasks.push_back(std::move(task));
+	}
+
+	m_TaskCondition.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock lock(m_Mutex);
+	m_IdleCondition.wait(lock, [this]() {
+		return m_Tasks.empty() && m_NumBusy == 0;
+	});
+}
+
+size_t ThreadPool::getHardwareThreads()
+{
+	return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void ThreadPool::work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock lock(m_Mutex);
+			m_TaskCondition.wait(lock, [this]() {
+				return m_IsStopping || !m_Tasks.empty();
+			});
+
+			if (m_Tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+			m_NumBusy++;
+		}
+
+		task();
+
+		{
+			std::lock_guard lock(m_Mutex);
+			m_NumBusy--;
+
+			if (m_Tasks.empty() && m_NumBusy == 0)
+			{
+				m_IdleCondition.notify_all();
+			}
+		}
+	}
+}
\ No newline at end of file
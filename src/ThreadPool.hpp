@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed number of worker threads running queued tasks in the order they were
+// queued (though not necessarily finishing in that order).
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t numThreads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &pool) = delete;
+	ThreadPool &operator=(const ThreadPool &pool) = delete;
+
+	size_t getNumThreads() const;
+
+	void push(std::function<void()> &&task);
+
+	// Blocks until every queued task has finished
+	void wait();
+
+	// Number of hardware threads, at least one
+	static size_t getHardwareThreads();
+
+private:
+	void work();
+
+private:
+	std::vector<std::thread> m_Threads;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_TaskCondition;
+	std::condition_variable m_IdleCondition;
+
+	std::deque<std::function<void()>> m_Tasks;
+	size_t m_NumBusy = 0;
+	bool m_IsStopping = false;
+};
\ No newline at end of file
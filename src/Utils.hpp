@@ -11,5 +11,15 @@ bool isReservedLoc(const Loc_t& loc);
 std::optional<Loc_t> getReservedLocFromId(const std::string_view &id);
 std::optional<std::string> getIdFromReservedLoc(const Loc_t &loc);
 
+// Locations created by 'new' (numbered per machine)
+Loc_t getFreshLoc(uint32_t index);
+// Locations created by 'chan' (numbered per process)
+Loc_t getChannelLoc(uint32_t index);
+bool isChannelLoc(Loc_t loc);
+// Name of any location, including fresh ones
+std::string getLocName(const Loc_t &loc);
+
+std::string stringifyTermKind(size_t kindIndex);
+// For printing many values, a 'Printer' avoids allocating for each
 std::string stringifyTerm(TermHandle_t term, bool omitNil = true);
-std::string stringifyClosure(Closure_t closure, bool omitNil = true);
\ No newline at end of file
+std::string stringifyClosure(const Closure_t &closure, bool omitNil = true);
\ No newline at end of file
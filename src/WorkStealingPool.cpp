@@ -0,0 +1,219 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+
+WorkStealingPool::Task::Task(Func_t &&func)
+	: m_Func(std::move(func))
+{}
+
+bool WorkStealingPool::Task::isDone() const
+{
+	return m_State == State::Done;
+}
+
+WorkStealingPool::WorkStealingPool(size_t numThreads)
+{
+	numThreads = std::max<size_t>(numThreads, 1);
+
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_Workers.push_back(std::make_unique<Worker>());
+	}
+
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_Threads.emplace_back(&WorkStealingPool::work, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard lock(m_Mutex);
+		m_IsStopping = true;
+	}
+
+	m_TaskCondition.notify_all();
+
+	for (std::thread &thread : m_Threads)
+	{
+		thread.join();
+	}
+}
+
+size_t WorkStealingPool::getNumThreads() const
+{
+	return m_Threads.size();
+}
+
+WorkStealingPool::TaskHandle_t WorkStealingPool::push(Func_t &&func)
+{
+	TaskHandle_t task = std::make_shared<Task>(std::move(func));
+	enqueue(task, true);
+	return task;
+}
+
+void WorkStealingPool::join(const TaskHandle_t &task)
+{
+	// Still queued, so run here rather than waiting for a worker to take it
+	// (the worker skips it when it does)
+	while (tryRun(task, true))
+	{
+	}
+
+	std::unique_lock lock(task->m_Mutex);
+	task->m_DoneCondition.wait(lock, [&]() {
+		return task->m_State == Task::State::Done;
+	});
+}
+
+void WorkStealingPool::wake(const TaskHandle_t &task)
+{
+	task->m_IsWoken = true;
+
+	Task::State expected = Task::State::Waiting;
+	if (task->m_State.compare_exchange_strong(expected, Task::State::Queued))
+	{
+		enqueue(task, false);
+	}
+}
+
+WorkStealingPool &WorkStealingPool::getShared()
+{
+	static WorkStealingPool pool(ThreadPool::getHardwareThreads());
+	return pool;
+}
+
+void WorkStealingPool::work(size_t index)
+{
+	while (true)
+	{
+		if (TaskHandle_t task = tryTake(index))
+		{
+			tryRun(task, false);
+			continue;
+		}
+
+		std::unique_lock lock(m_Mutex);
+		m_TaskCondition.wait(lock, [this]() {
+			return m_IsStopping || m_NumQueued > 0;
+		});
+
+		if (m_IsStopping && m_NumQueued == 0)
+		{
+			return;
+		}
+	}
+}
+
+WorkStealingPool::TaskHandle_t WorkStealingPool::tryTake(size_t index)
+{
+	TaskHandle_t task;
+
+	for (size_t i = 0; i < m_Workers.size() && !task; ++i)
+	{
+		Worker &worker = *m_Workers[(index + i) % m_Workers.size()];
+
+		std::lock_guard lock(worker.Mutex);
+		if (worker.Tasks.empty())
+		{
+			continue;
+		}
+
+		// Own tasks newest first, stolen ones oldest first
+		if (i == 0)
+		{
+			task = std::move(worker.Tasks.back());
+			worker.Tasks.pop_back();
+		}
+		else
+		{
+			task = std::move(worker.Tasks.front());
+			worker.Tasks.pop_front();
+		}
+	}
+
+	if (task)
+	{
+		m_NumQueued--;
+	}
+
+	return task;
+}
+
+void WorkStealingPool::enqueue(TaskHandle_t task, bool isNew)
+{
+	Worker &worker = *m_Workers[m_NextWorker++ % m_Workers.size()];
+	{
+		std::lock_guard lock(worker.Mutex);
+
+		if (isNew)
+		{
+			worker.Tasks.push_back(std::move(task));
+		}
+		else
+		{
+			worker.Tasks.push_front(std::move(task));
+		}
+	}
+
+	// Counted under the lock so a worker can't miss it while going to sleep
+	{
+		std::lock_guard lock(m_Mutex);
+		m_NumQueued++;
+	}
+
+	m_TaskCondition.notify_one();
+}
+
+bool WorkStealingPool::tryRun(const TaskHandle_t &task, bool isJoining)
+{
+	Task::State expected = Task::State::Queued;
+	if (!task->m_State.compare_exchange_strong(expected, Task::State::Running))
+	{
+		return false;
+	}
+
+	// Anything which changed before the step is seen by the step itself
+	task->m_IsWoken = false;
+
+	Step step = task->m_Func([this, task]() { wake(task); });
+
+	if (step == Step::Yield)
+	{
+		task->m_State = Task::State::Queued;
+
+		// Joining it, so it's run again here
+		if (isJoining)
+		{
+			return true;
+		}
+
+		enqueue(task, false);
+	}
+	else if (step == Step::Wait)
+	{
+		task->m_State = Task::State::Waiting;
+
+		// Woken while it was running, which 'wake' couldn't queue
+		if (task->m_IsWoken)
+		{
+			wake(task);
+		}
+	}
+	else
+	{
+		task->m_Func = nullptr;
+
+		{
+			std::lock_guard lock(task->m_Mutex);
+			task->m_State = Task::State::Done;
+		}
+
+		task->m_DoneCondition.notify_all();
+	}
+
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Worker threads each with a queue of their own, taking the newest task of
+// their queue first and stealing the oldest of another's when theirs is empty.
+// Tasks are joined one at a time, a task which no worker has started yet being
+// run by the thread joining it (so joining never waits on a queued task).
+//
+// A task runs in steps, each saying whether it's done, has more to do (so it's
+// queued again behind the others) or is waiting on something. A waiting task
+// holds no thread, it's queued again once whatever it waits on calls the wake
+// function it was given.
+class WorkStealingPool
+{
+public:
+	enum class Step { Done, Yield, Wait };
+
+	using Wake_t = std::function<void()>;
+	using Func_t = std::function<Step(const Wake_t &wake)>;
+
+	class Task
+	{
+	public:
+		explicit Task(Func_t &&func);
+
+		bool isDone() const;
+
+	private:
+		friend class WorkStealingPool;
+
+		enum class State { Queued, Running, Waiting, Done };
+
+	private:
+		Func_t m_Func;
+		std::atomic<State> m_State = State::Queued;
+		// Set by a wake while it's running, so the wake isn't lost
+		std::atomic<bool> m_IsWoken = false;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_DoneCondition;
+	};
+
+	using TaskHandle_t = std::shared_ptr<Task>;
+
+	explicit WorkStealingPool(size_t numThreads);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool &pool) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool &pool) = delete;
+
+	size_t getNumThreads() const;
+
+	TaskHandle_t push(Func_t &&func);
+
+	// Blocks until the task has finished
+	void join(const TaskHandle_t &task);
+
+	// Queues the task again if it's waiting (it's run even if what it waits
+	// on isn't ready, so it can check for itself)
+	void wake(const TaskHandle_t &task);
+
+	// Pool with a worker per hardware thread, started when first used
+	static WorkStealingPool &getShared();
+
+private:
+	struct Worker
+	{
+		std::mutex Mutex;
+		std::deque<TaskHandle_t> Tasks;
+	};
+
+	void work(size_t index);
+
+	// Queued tasks which were already run go to the front, behind new ones
+	void enqueue(TaskHandle_t task, bool isNew);
+
+	// Newest task of the worker, or else the oldest of any other
+	TaskHandle_t tryTake(size_t index);
+
+	// Runs a step of the task unless it was already taken (by a worker or by
+	// joining it), true if the step yielded & the task wasn't queued again
+	bool tryRun(const TaskHandle_t &task, bool isJoining);
+
+private:
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::vector<std::thread> m_Threads;
+
+	// Workers are given pushed tasks in turn
+	std::atomic<size_t> m_NextWorker = 0;
+
+	// Idle workers sleep until there's something queued
+	std::mutex m_Mutex;
+	std::condition_variable m_TaskCondition;
+	std::atomic<size_t> m_NumQueued = 0;
+	bool m_IsStopping = false;
+};
\ No newline at end of file